@@ -28,9 +28,13 @@
 #include "xwline.hpp"
 #include "platform_api.hpp"
 #include "canvas.hpp"
+#include "rasterizer.hpp"
+#include "depth_format.hpp"
+#include "depth_pyramid.hpp"
 
 #include <limits>
 #include <tuple>
+#include <vector>
 
 namespace studio
 {
@@ -42,6 +46,34 @@ namespace studio
 	template <>
 	struct PixelSelect<24> { typedef Color type; };
 
+	// Memory layout of the pixel types; runs of shaded colors are
+	// written through these, without the per-channel switch of
+	// Color::channel().
+	template <typename Pixel>
+	struct PixelFormat;
+
+	template <>
+	struct PixelFormat<Grayscale>
+	{
+		static const BitmapType type = BitmapType::G8;
+		enum { bytes = 1 };
+		static void store(u8* dst, const Grayscale& pixel) { *dst = pixel.Y; }
+		static void store(u8* dst, const Color& color) { *dst = Grayscale(color).Y; }
+	};
+
+	template <>
+	struct PixelFormat<Color>
+	{
+		static const BitmapType type = BitmapType::RGB24;
+		enum { bytes = 3 };
+		static void store(u8* dst, const Color& color)
+		{
+			dst[0] = color.B;
+			dst[1] = color.G;
+			dst[2] = color.R;
+		}
+	};
+
 	template <size_t BPP>
 	struct RawBitmap
 	{
@@ -95,11 +127,7 @@ namespace studio
 			{
 				return;
 			}
-			u8* dst = getDst(x, y);
-			for (size_t i = 0; i < (BPP >> 3); i++)
-			{
-				*dst++ = color.channel(i);
-			}
+			PixelFormat<Pixel>::store(getDst(x, y), color);
 		}
 		void blend(int x, int y, const fixed& depth, const fixed& brightness)
 		{
@@ -152,11 +180,16 @@ namespace studio
 	{
 		CanvasImpl()
 			: m_renderType(Render::Wireframe)
+			, m_rasterType(Raster::HalfSpace)
+			, m_deferred(false)
 		{
 		}
 
 		void line(const math::Point& start, const math::Point& stop, const fixed& startDepth, const fixed& stopDepth) override
 		{
+			// lines are drawn right away, they must see all the
+			// triangles sent before them
+			flush();
 			auto pThis = static_cast<T*>(this);
 			make_xwdrawer(*pThis).draw(tr(start), tr(stop), startDepth, stopDepth);
 		}
@@ -169,12 +202,28 @@ namespace studio
 		{
 		}
 
-		void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, Shader* shader) override
+		void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, const ShaderPtr& shader) override
+		{
+		}
+
+		void flush() override
 		{
 		}
 
 		Render getRenderType() const override { return m_renderType; }
+		int width() const override { return static_cast<const T*>(this)->m_width; }
+		int height() const override { return static_cast<const T*>(this)->m_height; }
+		// plain bitmaps keep no depth to be occluded by
+		bool isOccluded(const math::Point& lo, const math::Point& hi, const fixed& nearest) override { return false; }
 		void setRenderType(Render renderType) { m_renderType = renderType; }
+		Raster getRasterType() const { return m_rasterType; }
+		void setRasterType(Raster rasterType) { m_rasterType = rasterType; }
+		// Deferred shading: the half-space fills only keep the depth and
+		// the front-most triangle of every pixel and the shaders run on
+		// flush, once per visible pixel. Scanline fills are always shaded
+		// right away.
+		bool isDeferred() const { return m_deferred; }
+		void setDeferred(bool deferred) { m_deferred = deferred; }
 
 		inline math::Point tr(const math::Point& pt) const
 		{
@@ -189,6 +238,8 @@ namespace studio
 		}
 	private:
 		Render m_renderType;
+		Raster m_rasterType;
+		bool m_deferred;
 	};
 
 	struct GrayscaleBitmap : public CanvasImpl<GrayscaleBitmap>, public PlatformBitmap<BitmapType::G8>
@@ -200,25 +251,98 @@ namespace studio
 		}
 	};
 
-	template <typename T>
+	// One bit per pixel, set where the pixel is in the shadow of a
+	// light. Every row starts in a word of its own, so the rows may be
+	// set from different threads.
+	class ShadowMask
+	{
+		int m_width;
+		int m_height;
+		int m_stride; // words per row
+		std::vector<u32> m_bits;
+	public:
+		ShadowMask(int w, int h)
+			: m_width(w)
+			, m_height(h)
+			, m_stride((w + 31) >> 5)
+			, m_bits(m_stride * h, 0)
+		{
+		}
+
+		int width() const { return m_width; }
+		int height() const { return m_height; }
+		const u32* row(int y) const { return &m_bits[y * m_stride]; }
+
+		void set(int x, int y) { m_bits[y * m_stride + (x >> 5)] |= 1u << (x & 31); }
+		bool test(int x, int y) const { return (row(y)[x >> 5] & (1u << (x & 31))) != 0; }
+
+		// black where the mask is set; for debugging
+		void save(const char* path) const
+		{
+			GrayscaleBitmap bitmap(m_width, m_height);
+			for (int y = 0; y < m_height; ++y)
+			{
+				for (int x = 0; x < m_width; ++x)
+				{
+					if (test(x, y))
+						bitmap.plot(x, y, Grayscale::black());
+				}
+			}
+			bitmap.save(path);
+		}
+	};
+	typedef std::shared_ptr<ShadowMask> ShadowMaskPtr;
+
+	template <typename T, typename Format = depth_format>
 	class DepthMap
 	{
-		fixed* m_depth;
-		fixed m_minSet;
-		fixed m_maxSet;
+	public:
+		typedef Format format;
+		typedef typename Format::value_type value_type;
+
+	private:
+		value_type* m_depth;
+		DepthRange m_range;
+
+		// Hierarchical Z: the farthest depth of every TILE x TILE block.
+		// Depth writes only ever bring a pixel closer, so a stale entry
+		// is still a safe bound; the writes just mark the tile dirty and
+		// the entry is brought up to date when it is needed next.
+		enum { HIZ_TILE = raster::TILE };
+		int m_tilesX;
+		std::vector<value_type> m_tileFar;
+		std::vector<u8> m_tileDirty;
+
+		const value_type& tileFar(int tileX, int tileY)
+		{
+			auto index = tileY * m_tilesX + tileX;
+			auto& bound = m_tileFar[index];
+			if (!m_tileDirty[index])
+				return bound;
+			m_tileDirty[index] = 0;
+
+			auto pT = static_cast<T*>(this);
+			int x0 = tileX * HIZ_TILE, x1 = std::min(x0 + HIZ_TILE, pT->m_width);
+			int y0 = tileY * HIZ_TILE, y1 = std::min(y0 + HIZ_TILE, pT->m_height);
+			bound = m_depth[y0 * pT->m_width + x0];
+			for (int y = y0; y < y1; ++y)
+			{
+				auto line = m_depth + y * pT->m_width;
+				for (int x = x0; x < x1; ++x)
+					if (Format::closer(bound, line[x]))
+						bound = line[x];
+			}
+			return bound;
+		}
 
 	public:
 		DepthMap(int w, int h)
-			: m_depth(new fixed[w*h])
-			, m_minSet(std::numeric_limits<long double>::max())
-			, m_maxSet(std::numeric_limits<long double>::min())
+			: m_depth(new value_type[w*h])
+			, m_tilesX((w + HIZ_TILE - 1) / HIZ_TILE)
+			, m_tileFar(m_tilesX * ((h + HIZ_TILE - 1) / HIZ_TILE), Format::clear())
+			, m_tileDirty(m_tileFar.size(), 0)
 		{
-			fixed* ptr = m_depth;
-			fixed* end = m_depth + w*h;
-			while (ptr != end)
-			{
-				*ptr++ = fixed(std::numeric_limits<long double>::max());
-			}
+			std::fill(m_depth, m_depth + w*h, Format::clear());
 		}
 
 		~DepthMap()
@@ -234,39 +358,80 @@ namespace studio
 				return true;
 			}
 
-			fixed * ptr = static_cast<T*>(this)->m_depth + y * static_cast<T*>(this)->m_width + x;
-			if (*ptr > depth)
+			value_type * ptr = static_cast<T*>(this)->m_depth + y * static_cast<T*>(this)->m_width + x;
+			auto value = Format::encode(depth, m_range);
+			if (Format::closer(value, *ptr))
 			{
-				*ptr = depth;
-				if (m_minSet > depth) m_minSet = depth;
-				if (m_maxSet < depth) m_maxSet = depth;
+				*ptr = value;
+				m_tileDirty[(y / HIZ_TILE) * m_tilesX + x / HIZ_TILE] = 1;
 				return true;
 			}
 			return false;
 		}
 
+		// True, if nothing at the nearest depth could pass the depth test
+		// anywhere inside the pixel rectangle (inclusive). Tiles are only
+		// ever read by the thread owning their bin.
+		bool isHidden(int x0, int y0, int x1, int y1, const fixed& nearest)
+		{
+			auto pT = static_cast<T*>(this);
+			x0 = std::max(x0, 0);
+			y0 = std::max(y0, 0);
+			x1 = std::min(x1, pT->m_width - 1);
+			y1 = std::min(y1, pT->m_height - 1);
+			if (x0 > x1 || y0 > y1)
+				return true;
+
+			auto value = Format::encode(nearest, m_range);
+			for (int ty = y0 / HIZ_TILE; ty <= y1 / HIZ_TILE; ++ty)
+				for (int tx = x0 / HIZ_TILE; tx <= x1 / HIZ_TILE; ++tx)
+					if (Format::closer(value, tileFar(tx, ty)))
+						return false;
+			return true;
+		}
+
+		// view-space range covered by the integer formats; set it before
+		// rendering anything
+		void setDepthRange(const fixed& zNear, const fixed& zFar) { m_range = DepthRange(zNear, zFar); }
+		const DepthRange& depthRange() const { return m_range; }
+
 		void saveDepths(const char* path)
 		{
 			PlatformBitmap<BitmapType::G8> depths(static_cast<T*>(this)->m_width, static_cast<T*>(this)->m_height);
 			depths.erase();
 
-			auto dz = m_maxSet - m_minSet;
+			// the range is taken here and not in isAbove, which may run
+			// on many threads at once
+			fixed minSet = fixed::max();
+			fixed maxSet = fixed::lowest();
+			for (auto ptr = m_depth, end = m_depth + static_cast<T*>(this)->m_width * static_cast<T*>(this)->m_height; ptr != end; ++ptr)
+			{
+				if (*ptr == Format::clear())
+					continue;
+				auto z = Format::decode(*ptr, m_range);
+				if (minSet > z) minSet = z;
+				if (maxSet < z) maxSet = z;
+			}
+
+			auto dz = maxSet - minSet;
 			for (int y = 0; y < static_cast<T*>(this)->m_height; ++y)
 			{
 				auto line = m_depth + y * static_cast<T*>(this)->m_width;
 				for (int x = 0; x < static_cast<T*>(this)->m_width; ++x)
 				{
-					auto z = *line++;
-					if (z > m_maxSet || z < m_minSet)
+					auto raw = *line++;
+					if (raw == Format::clear())
 						continue;
+					auto z = Format::decode(raw, m_range);
 
-					depths.plot(x, y, Grayscale { cast<u8>(0x40 + (m_maxSet - z)*(255 - 0x40) / dz) });
+					depths.plot(x, y, Grayscale { cast<u8>(0x40 + (maxSet - z)*(255 - 0x40) / dz) });
 				}
 			}
 			depths.save(path);
 		}
 
-		const fixed& getDepth(int x, int y) const { return m_depth[y * static_cast<const T*>(this)->m_width + x]; }
+		bool hasDepth(int x, int y) const { return m_depth[y * static_cast<const T*>(this)->m_width + x] != Format::clear(); }
+		fixed getDepth(int x, int y) const { return Format::decode(m_depth[y * static_cast<const T*>(this)->m_width + x], m_range); }
 
 		bool isInside(int x, int y) const
 		{
@@ -313,7 +478,7 @@ namespace studio
 					std::swap(this->x, this->y);
 			}
 
-			const fixed& depth(int x, int y) const
+			fixed depth(int x, int y) const
 			{
 				if (steep) return ref.getDepth(y, x);
 				return ref.getDepth(x, y);
@@ -329,6 +494,21 @@ namespace studio
 			{
 				return std::make_pair(y.interpolate(_x, x.dv), z.interpolate(_x, x.dv));
 			}
+
+			// nearest and farthest depth around the stretch between the
+			// two points; false, if it leaves the bitmap
+			bool bounds(const DepthPyramid& pyramid, int level, int x0, int y0, int x1, int y1, fixed& nearest, fixed& farthest) const
+			{
+				if (steep)
+				{
+					std::swap(x0, y0);
+					std::swap(x1, y1);
+				}
+				if (!ref.isInside(x0, y0) || !ref.isInside(x1, y1))
+					return false;
+				pyramid.bounds(level, std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1), nearest, farthest);
+				return true;
+			}
 		};
 
 		bool isBlockedFrom(int x, int y, int X, int Y, fixed Z)
@@ -347,7 +527,7 @@ namespace studio
 			return false;
 		}
 
-		std::shared_ptr<PlatformBitmap<BitmapType::G8>> calcShadow(const math::Point& light, const fixed& Z) const
+		ShadowMaskPtr calcShadow(const math::Point& light, const fixed& Z) const
 		{
 			auto pT = static_cast<const T*>(this);
 			auto black = Grayscale::black();
@@ -355,132 +535,400 @@ namespace studio
 			auto X = cast<int>(tr.x());
 			auto Y = cast<int>(tr.y());
 
-			auto shadow = std::make_shared<GrayscaleBitmap>(pT->m_width, pT->m_height);
-			shadow->erase();
+			auto shadow = std::make_shared<ShadowMask>(pT->m_width, pT->m_height);
+
+			DepthPyramid pyramid(pT->m_width, pT->m_height, [&](int x, int y) { return getDepth(x, y); });
+			auto top = pyramid.levels() - 1;
+
 			auto depths = [&](const math::Point& test) -> bool {
 				auto pt = pT->tr(test);
 				DepthPlotter dp{ *this, cast<int>(pt.x()), cast<int>(pt.y()), getDepth(cast<int>(pt.x()), cast<int>(pt.y())), X, Y, Z };
 
-				Grayscale end = Grayscale::white();
-				for (int _x = 0; _x < dp.x.dv; ++_x)
+				// The ray is walked in stretches of 2^level steps. A stretch
+				// staying in front of the nearest depth around it cannot be
+				// blocked and the next one is twice as long; one behind the
+				// farthest depth is blocked for sure; anything else is
+				// split in halves, down to the single pixels.
+				int level = 0;
+				int _x = 0;
+				while (_x < dp.x.dv)
 				{
 					int x = dp.x.v0 + _x;
 					int y;
 					fixed z;
 					std::tie(y, z) = dp.interpolate(_x);
-					if (dp.isInside(x, y))
+
+					if (!level)
 					{
-						auto z1 = dp.depth(x, y);
-						if (z > z1)
+						if (!dp.isInside(x, y))
+							return true;
+						if (z > dp.depth(x, y))
 							return false;
+						++_x;
+						level = std::min(1, top);
+						continue;
 					}
-					else
-						return true;
+
+					int last = std::min(_x + (1 << level), dp.x.dv) - 1;
+					int y1;
+					fixed z1;
+					std::tie(y1, z1) = dp.interpolate(last);
+
+					fixed nearest, farthest;
+					if (!dp.bounds(pyramid, level, x, y, dp.x.v0 + last, y1, nearest, farthest))
+					{
+						--level;
+						continue;
+					}
+
+					if (std::max(z, z1) <= nearest)
+					{
+						_x = last + 1;
+						level = std::min(level + 1, top);
+						continue;
+					}
+
+					if (std::min(z, z1) > farthest)
+						return false;
+
+					--level;
 				}
 				return true;
 			};
 
+			// bands of rows spread over the thread pool; every thread
+			// plots its own rows of the mask only
+			enum { BAND = 16 };
 			auto dx = pT->m_width / 2;
 			auto dy = pT->m_height / 2;
-			for (int y = 0; y < pT->m_height; y++)
-			{
-				for (int x = 0; x < pT->m_width; x++)
+			ThreadPool::instance().parallel_for((pT->m_height + BAND - 1) / BAND, [&](size_t band) {
+				auto y0 = (int) band * BAND;
+				auto y1 = std::min(y0 + (int) BAND, pT->m_height);
+				for (int y = y0; y < y1; y++)
 				{
-					if (!depths({ x - dx, y - dy }))
+					for (int x = 0; x < pT->m_width; x++)
 					{
-						shadow->plot(x, y, Grayscale::black());
-						//pT->blend(x, y, Color::black(), fixed(82)/1000);
+						if (!depths({ x - dx, y - dy }))
+							shadow->set(x, y);
 					}
 				}
-			}
+			});
 			return shadow;
 		}
 
-		void applyShadow(const PlatformBitmap<BitmapType::G8>* shadow)
+		// Darkens the pixels by every mask they are set in, all the
+		// lights in one pass. A pixel in n shadows goes through the n-th
+		// row of a table made by blending every channel value with black
+		// n times over, so the result is the same as blending the masks
+		// one after another.
+		void applyShadow(const std::vector<ShadowMaskPtr>& masks)
 		{
-			auto sh = shadow->m_pixels;
+			typedef PixelFormat<typename T::Pixel> Layout;
+
 			auto pT = static_cast<T*>(this);
+			auto brightness = fixed(82) * 0xFF / (1000 * 0xFF);
+			std::vector<u8> lut((masks.size() + 1) * 256);
+			for (int v = 0; v < 256; ++v)
+				lut[v] = (u8) v;
+			for (size_t n = 1; n <= masks.size(); ++n)
+			{
+				for (int v = 0; v < 256; ++v)
+					lut[n * 256 + v] = T::blendChannel(0, lut[(n - 1) * 256 + v], brightness);
+			}
+
+			std::vector<const u32*> rows(masks.size());
 			for (int y = 0; y < pT->m_height; y++)
 			{
-				auto src = sh + y * shadow->stride();
-				for (int x = 0; x < pT->m_width; x++)
+				for (size_t i = 0; i < masks.size(); ++i)
+					rows[i] = masks[i]->row(y);
+
+				auto line = pT->getDst(0, y);
+				for (int word = 0; word * 32 < pT->m_width; ++word)
 				{
-					auto c = *src++;
-					if (c == 0xFF)
-						continue;
-					c = 0xFF - c;
-					pT->blend(x, y, Color::black(), fixed(82) * c / (1000*0xFF));
+					u32 any = 0;
+					for (auto && row : rows)
+						any |= row[word];
+
+					for (int bit = 0; any; ++bit, any >>= 1)
+					{
+						if (!(any & 1))
+							continue;
+
+						size_t n = 0;
+						for (auto && row : rows)
+							n += (row[word] >> bit) & 1;
+
+						auto shade = &lut[n * 256];
+						auto dst = line + (word * 32 + bit) * Layout::bytes;
+						for (int i = 0; i < Layout::bytes; ++i)
+							dst[i] = shade[dst[i]];
+					}
 				}
 			}
 		}
 	};
 
-	struct GrayscaleDepthBitmap : public CanvasImpl<GrayscaleDepthBitmap>, public DepthMap<GrayscaleDepthBitmap>, public PlatformBitmap<BitmapType::G8>
+	struct ColorBitmap : public CanvasImpl<ColorBitmap>, public PlatformBitmap<BitmapType::RGB24>
 	{
-		GrayscaleDepthBitmap(int w, int h)
-			: PlatformBitmap<BitmapType::G8>(w, h)
-			, DepthMap<GrayscaleDepthBitmap>(w, h)
+		ColorBitmap(int w, int h)
+			: PlatformBitmap<BitmapType::RGB24>(w, h)
 		{
 			erase();
 		}
+	};
+
+	// Depth-tested canvas for any pixel type and depth format. Both the
+	// scanline and the half-space filler end up in span(), instantiated
+	// for the final class of the shader (see dispatch()), so the loops
+	// run per pixel make no virtual calls and write the pixels straight
+	// in their own layout.
+	template <typename Pixel, typename Format = depth_format>
+	struct DepthBitmap : public CanvasImpl<DepthBitmap<Pixel, Format>>, public DepthMap<DepthBitmap<Pixel, Format>, Format>, public PlatformBitmap<PixelFormat<Pixel>::type>
+	{
+		typedef PlatformBitmap<PixelFormat<Pixel>::type> Bitmap;
+		typedef DepthMap<DepthBitmap<Pixel, Format>, Format> Depths;
+
+		raster::Bins m_bins;
+		raster::IdBuffer m_ids;
+
+		DepthBitmap(int w, int h)
+			: Bitmap(w, h)
+			, Depths(w, h)
+			, m_bins(w, h)
+			, m_ids(w, h)
+		{
+			this->erase();
+		}
 		void blend(int x, int y, const fixed& depth, const fixed& brightness)
 		{
-			if (isAbove(x, y, depth))
-				PlatformBitmap<BitmapType::G8>::blend(x, y, depth, brightness);
+			if (this->isAbove(x, y, depth))
+				Bitmap::blend(x, y, depth, brightness);
+		}
+		void blend(int x, int y, const Color& color, const fixed& brightness)
+		{
+			Bitmap::blend(x, y, Pixel(color), brightness);
 		}
 
-		void floodLine(int y, int start, int stop, const fixed& startDepth, const fixed& stopDepth, Shader* shader);
-		void floodFill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, Shader* shader);
 		void flood(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3) override
 		{
-			UniformShader black(Color::black());
-			floodFill(p1, p2, p3, &black);
+			fill(p1, p2, p3, std::make_shared<UniformShader>(Color::black()));
 		}
-		void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, Shader* shader) override
+
+		// Against the depth already written; the triangles still in the
+		// bins are not there yet, which only makes the answer cautious.
+		// Once OCCLUSION_BATCH of them are waiting, they are rasterized
+		// first (their shading, if deferred, is still left for flush()),
+		// so the test does not go blind for the rest of the frame, while
+		// the bins are still flushed in large batches.
+		bool isOccluded(const math::Point& lo, const math::Point& hi, const fixed& nearest) override
 		{
-			floodFill(p1, p2, p3, shader);
+			if (m_bins.size() >= OCCLUSION_BATCH)
+				rasterizeBins();
+			auto p0 = this->tr(lo);
+			auto p1 = this->tr(hi);
+			return this->isHidden(cast<int>(p0.x()), cast<int>(p0.y()), cast<int>(p1.x()) + 1, cast<int>(p1.y()) + 1, nearest);
+		}
+		void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, const ShaderPtr& shader) override
+		{
+			if (this->getRasterType() == Raster::HalfSpace)
+				halfSpaceFill(p1, p2, p3, shader);
+			else
+			{
+				flush();
+				dispatch(shader.get(), ScanlineFill { this, p1, p2, p3 });
+			}
+		}
+		void flush() override
+		{
+			rasterizeBins();
+			m_ids.resolve([this](Shader* shader, int x, int y, int count) {
+				dispatch(shader, ResolveRun { this, x, y, count });
+			});
 		}
-	};
 
-	struct ColorBitmap : public CanvasImpl<ColorBitmap>, public PlatformBitmap<BitmapType::RGB24>
-	{
-		ColorBitmap(int w, int h)
-			: PlatformBitmap<BitmapType::RGB24>(w, h)
+	private:
+		enum
 		{
-			erase();
+			SPAN = 64,
+			OCCLUSION_BATCH = 4096
+		};
+
+		void rasterizeBins()
+		{
+			m_bins.flush([this](const raster::Setup& setup, Shader* shader, u32 id, int x0, int y0, int x1, int y1) {
+				dispatch(shader, BinFill { this, setup, id, x0, y0, x1, y1 });
+			});
 		}
-	};
 
-	struct ColorDepthBitmap : public CanvasImpl<ColorDepthBitmap>, public DepthMap<ColorDepthBitmap>, public PlatformBitmap<BitmapType::RGB24>
-	{
-		ColorDepthBitmap(int w, int h)
-			: PlatformBitmap<BitmapType::RGB24>(w, h)
-			, DepthMap<ColorDepthBitmap>(w, h)
+		// the shader type is only known inside dispatch(); these carry the
+		// rest of the arguments over to the member templates
+		struct ScanlineFill
 		{
-			erase();
+			DepthBitmap* bmp;
+			const PointWithDepth& p1;
+			const PointWithDepth& p2;
+			const PointWithDepth& p3;
+			template <typename S> void operator()(S* shader) const { bmp->floodFill(p1, p2, p3, shader); }
+		};
+
+		struct BinFill
+		{
+			DepthBitmap* bmp;
+			const raster::Setup& setup;
+			u32 id;
+			int x0, y0, x1, y1;
+			template <typename S> void operator()(S* shader) const { bmp->tiles(setup, shader, id, x0, y0, x1, y1); }
+		};
+
+		struct ResolveRun
+		{
+			DepthBitmap* bmp;
+			int x, y, count;
+			template <typename S> void operator()(S* shader) const { bmp->shadeRun(shader, x, y, count); }
+		};
+
+		// Shades a run of count pixels, which all passed the depth test, in
+		// chunks of at most SPAN pixels.
+		template <typename S>
+		void shadeRun(S* shader, int x, int y, int count)
+		{
+			Color colors[SPAN];
+			auto dst = this->getDst(x, y);
+			while (count > 0)
+			{
+				int length = std::min(count, (int) SPAN);
+				shader->shadeSpan(this->revTr({ fixed(x), fixed(y) }), 1, length, colors);
+				for (int i = 0; i < length; ++i, dst += PixelFormat<Pixel>::bytes)
+					PixelFormat<Pixel>::store(dst, colors[i]);
+				x += length;
+				count -= length;
+			}
 		}
-		void blend(int x, int y, const fixed& depth, const fixed& brightness)
+
+		// Depth-tests count pixels of row y, starting at x with depth z,
+		// which moves by dz every pixel. With an ID, the visible pixels are
+		// left for the deferred resolve, otherwise every run of them is
+		// shaded right away.
+		template <typename S>
+		void span(S* shader, u32 id, int x, int y, int count, fixed z, const fixed& dz)
 		{
-			if (isAbove(x, y, depth))
-				PlatformBitmap<BitmapType::RGB24>::blend(x, y, depth, brightness);
+			// only the scanline filler ever reaches outside
+			if (y < 0 || y >= this->m_height)
+				return;
+			if (x < 0)
+			{
+				z += dz * -x;
+				count += x;
+				x = 0;
+			}
+			count = std::min(count, this->m_width - x);
+
+			int run = 0;
+			for (int i = 0; i < count; ++i, z += dz)
+			{
+				if (this->isAbove(x + i, y, z))
+				{
+					if (id)
+						m_ids.set(x + i, y, id);
+					else
+						++run;
+					continue;
+				}
+				if (run)
+					shadeRun(shader, x + i - run, y, run);
+				run = 0;
+			}
+			if (run)
+				shadeRun(shader, x + count - run, y, run);
 		}
-		void blend(int x, int y, const Color& color, const fixed& brightness)
+
+		template <typename S>
+		void tiles(const raster::Setup& setup, S* shader, u32 id, int x0, int y0, int x1, int y1)
 		{
-			PlatformBitmap<BitmapType::RGB24>::blend(x, y, color, brightness);
+			for (int y = y0; y <= y1; y += raster::TILE)
+			{
+				for (int x = x0; x <= x1; x += raster::TILE)
+				{
+					if (this->isHidden(x, y, x + raster::TILE - 1, y + raster::TILE - 1, setup.m_nearest))
+						continue;
+					raster::tile(setup, x, y, [&](int x, int y, int count, const fixed& z, const fixed& dz) {
+						span(shader, id, x, y, count, z, dz);
+					});
+				}
+			}
 		}
 
-		void floodLine(int y, int start, int stop, const fixed& startDepth, const fixed& stopDepth, Shader* shader);
-		void floodFill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, Shader* shader);
-		void flood(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3) override
+		// triangle-level HiZ test for the scanline filler
+		bool isTriangleHidden(const PointWithDepth (&pts)[3])
 		{
-			UniformShader black(Color::black());
-			floodFill(p1, p2, p3, &black);
+			fixed minX = std::min({ pts[0].m_pos.x(), pts[1].m_pos.x(), pts[2].m_pos.x() });
+			fixed maxX = std::max({ pts[0].m_pos.x(), pts[1].m_pos.x(), pts[2].m_pos.x() });
+			fixed nearest = std::min({ pts[0].m_depth, pts[1].m_depth, pts[2].m_depth });
+			return this->isHidden(cast<int>(minX) - 1, cast<int>(pts[0].m_pos.y()), cast<int>(maxX) + 1, cast<int>(pts[2].m_pos.y()) + 1, nearest);
 		}
-		void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, Shader* shader) override
+
+		template <typename S>
+		void floodFill(const PointWithDepth& _p1, const PointWithDepth& _p2, const PointWithDepth& _p3, S* shader)
+		{
+			PointWithDepth pts [] = { _p1, _p2, _p3 };
+			pts[0].m_pos = this->tr(pts[0].m_pos);
+			pts[1].m_pos = this->tr(pts[1].m_pos);
+			pts[2].m_pos = this->tr(pts[2].m_pos);
+
+			std::sort(pts, pts + 3, [](const PointWithDepth& lhs, const PointWithDepth& rhs) { return lhs.m_pos.y() < rhs.m_pos.y(); });
+
+			if (isTriangleHidden(pts))
+				return;
+
+			raster::Slope A(pts[0].m_pos.y(), pts[1].m_pos.y(), pts[0].m_pos.x(), pts[1].m_pos.x(), pts[0].m_depth, pts[1].m_depth);
+			raster::Slope B(pts[0].m_pos.y(), pts[2].m_pos.y(), pts[0].m_pos.x(), pts[2].m_pos.x(), pts[0].m_depth, pts[2].m_depth);
+			raster::Slope C(pts[1].m_pos.y(), pts[2].m_pos.y(), pts[1].m_pos.x(), pts[2].m_pos.x(), pts[1].m_depth, pts[2].m_depth);
+
+			int y0 = cast<int>(pts[0].m_pos.y() + 1);
+			int y1 = cast<int>(pts[1].m_pos.y() + 1);
+			int y2 = cast<int>(pts[2].m_pos.y() + 1);
+
+			// the rows off the bitmap would only be rejected by span()
+			for (int y = std::max(y0, 0), end = std::min(y2, this->m_height); y < end; y++)
+			{
+				fixed x0, x1, z0, z1;
+				B.calc(y, x0, z0);
+				(y < y1 ? A : C).calc(y, x1, z1);
+
+				if (x0 > x1)
+				{
+					std::swap(x0, x1);
+					std::swap(z0, z1);
+				}
+
+				int start = cast<int>(x0);
+				int count = cast<int>(x1) - start;
+				if (count > 0)
+					span(shader, 0, start, y, count, z0, (z1 - z0) / count);
+			}
+		}
+
+		void halfSpaceFill(const PointWithDepth& _p1, const PointWithDepth& _p2, const PointWithDepth& _p3, const ShaderPtr& shader)
 		{
-			floodFill(p1, p2, p3, shader);
+			PointWithDepth pts [] = { _p1, _p2, _p3 };
+			pts[0].m_pos = this->tr(pts[0].m_pos);
+			pts[1].m_pos = this->tr(pts[1].m_pos);
+			pts[2].m_pos = this->tr(pts[2].m_pos);
+
+			raster::Setup setup;
+			if (!setup.init(pts, this->m_width, this->m_height))
+				return;
+
+			// whole triangle behind what was already flushed
+			if (this->isHidden(setup.m_minX, setup.m_minY, setup.m_maxX, setup.m_maxY, setup.m_nearest))
+				return;
+
+			m_bins.add(setup, shader, this->isDeferred() ? m_ids.add(shader) : 0);
 		}
 	};
+
+	typedef DepthBitmap<Grayscale> GrayscaleDepthBitmap;
+	typedef DepthBitmap<Color> ColorDepthBitmap;
 }
 
 #endif //__LIBSTUDIO_BITMAP_HPP__
\ No newline at end of file
@@ -25,11 +25,11 @@
 #ifndef __LIBSTUDIO_BLOCK_HPP__
 #define __LIBSTUDIO_BLOCK_HPP__
 
-#include "container.hpp"
+#include "mesh.hpp"
 
 namespace studio
 {
-	class Block : public Container
+	class Block : public Mesh
 	{
 	public:
 		Block(const fixed& width, const fixed& height, const fixed& depth);
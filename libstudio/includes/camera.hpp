@@ -27,18 +27,44 @@
 
 #include "renderable.hpp"
 #include "canvas.hpp"
+#include "vertex_stream.hpp"
 #include <memory>
 
 namespace studio
 {
 	class Triangle;
+	class Mesh;
 
 	struct ICamera : public Renderable
 	{
-		virtual void render(const Triangle*, const math::Matrix&, const Lights& lights) const = 0;
+		virtual void render(const Triangle*, const math::Affine&, const Lights& lights) const = 0;
+		virtual void render(const Mesh*, const math::Affine&, const Lights& lights) const = 0;
 		virtual void renderLine(const math::Vertex& start, const math::Vertex& stop, const Lights& lights) const = 0;
-		void renderTo(const ICamera* cam, const math::Matrix& parent, const Lights& lights) const override {}
+		// invalidates everything cached for the previous frame
+		virtual void beginFrame() const = 0;
+		// waits for all the triangles sent so far to reach the canvas
+		virtual void flush() const = 0;
+		// false, if nothing of the object's bounds() could be seen, so
+		// the object and everything inside it may be skipped
+		virtual bool isVisible(const Renderable* object, const math::Affine& local) const { return true; }
+		void renderTo(const ICamera* cam, const math::Affine& parent, const Lights& lights) const override {}
 		MaterialPtr material() const override { return nullptr; }
+		Bounds bounds() const override { return Bounds(); }
+	};
+
+	// What a camera did with the faces of its last frame. The faces
+	// are culled only, when they are filled; the wireframe shows all
+	// of them.
+	struct CullStats
+	{
+		unsigned faces;      // all the faces sent to the camera
+		unsigned backFacing; // facing away from the eye
+		unsigned offScreen;  // completely outside of the canvas
+		unsigned clipped;    // cut by the near plane or the guard band
+		unsigned hidden;     // containers and meshes skipped by isVisible()
+
+		CullStats() : faces(0), backFacing(0), offScreen(0), clipped(0), hidden(0) {}
+		unsigned culled() const { return backFacing + offScreen; }
 	};
 
 	class Camera : public ICamera
@@ -47,12 +73,28 @@ namespace studio
 		math::Vertex m_position;
 		math::Vertex m_target;
 		std::shared_ptr<Canvas> m_canvas;
+		mutable unsigned m_frame;
+		mutable LightCachePtr m_lights; // m_lightsFrame's lights, in the camera space
+		mutable unsigned m_lightsFrame;
+		mutable CullStats m_stats;
+
+		void updateLights(const Lights& lights) const;
+		bool isBackFacing(const math::Vertex (&vertices)[3]) const;
+		bool isOffScreen(const math::Point* points, int count) const;
+		// clips a convex polygon in the camera space, returns the number
+		// of the corners left, 0 for nothing; polygon has to have room
+		// for count + 5 corners
+		int clip(math::Vertex* polygon, int count) const;
+		void renderFace(const math::VertexStream& stream, const u32* face, const MaterialPtr& material) const;
+		void renderFace(const math::Vertex (&vertices)[3], const math::Point (&points)[3], const MaterialPtr& material, Render renderType) const;
 
 	public:
 		Camera(const fixed& eye, const math::Vertex& position, const math::Vertex& target)
 			: m_eye(eye)
 			, m_position(position)
 			, m_target(target)
+			, m_frame(0)
+			, m_lightsFrame(0)
 		{}
 		template <typename T, typename... Args>
 		std::shared_ptr<T> create_canvas(Args&& ... args)
@@ -63,21 +105,31 @@ namespace studio
 		}
 
 		math::Vector normal() const { return m_target - m_position; }
-		void transform(math::Vertex& pt, const math::Matrix& local) const;
+		void transform(math::Vertex& pt, const math::Affine& local) const;
+		void transform(math::Vertex* points, size_t count, const math::Affine& local) const;
+		void transform(math::VertexStream& stream, const math::Affine& local) const;
 		fixed project(const fixed& z, const fixed& other) const
 		{
-			return other * m_eye / (m_eye + z);
+			return other * (m_eye / (m_eye + z));
 		}
 		math::Point project(const math::Vertex& pt) const
 		{
 			return { project(pt.z(), pt.x()), project(pt.z(), pt.y()) };
 		}
+		void project(math::VertexStream& stream) const { stream.project(m_eye); }
+
+		// inverse of transform() and project(): the world point seen at
+		// the screen point pt, at the depth z
+		math::Vertex unproject(const math::Point& pt, const fixed& z) const
+		{
+			auto ratio = (m_eye + z) / m_eye;
+			return { pt.x() * ratio + m_position.x(), pt.y() * ratio + m_position.y(), z + m_position.z() };
+		}
 
 		template <size_t len>
-		void transformPoints(math::Vertex(&points)[len], const math::Matrix& local) const
+		void transformPoints(math::Vertex(&points)[len], const math::Affine& local) const
 		{
-			for (auto && pt : points)
-				transform(pt, local);
+			transform(points, len, local);
 		}
 
 		template <size_t len>
@@ -88,11 +140,18 @@ namespace studio
 				*dest++ = project(src);
 		}
 
-		virtual void render(const Triangle*, const math::Matrix&, const Lights& lights) const;
+		virtual void render(const Triangle*, const math::Affine&, const Lights& lights) const;
+		virtual void render(const Mesh*, const math::Affine&, const Lights& lights) const;
 		virtual void renderLine(const math::Vertex& start, const math::Vertex& stop, const Lights& lights) const;
+		void beginFrame() const override;
+		void flush() const override;
+		bool isVisible(const Renderable* object, const math::Affine& local) const override;
+		unsigned frame() const { return m_frame; }
+		const CullStats& stats() const { return m_stats; }
 
 		math::Vertex position() const { return m_position; }
 		math::Vertex target() const { return m_target; }
+		const fixed& eye() const { return m_eye; }
 	};
 
 	class StereoCamera : public ICamera
@@ -115,17 +174,40 @@ namespace studio
 			return ref;
 		}
 
-		void render(const Triangle* triangle, const math::Matrix& local, const Lights& lights) const override
+		void render(const Triangle* triangle, const math::Affine& local, const Lights& lights) const override
 		{
 			m_leftCam.render(triangle, local, lights);
 			m_rightCam.render(triangle, local, lights);
 		}
 
+		void render(const Mesh* mesh, const math::Affine& local, const Lights& lights) const override
+		{
+			m_leftCam.render(mesh, local, lights);
+			m_rightCam.render(mesh, local, lights);
+		}
+
 		void renderLine(const math::Vertex& start, const math::Vertex& stop, const Lights& lights) const override
 		{
 			m_leftCam.renderLine(start, stop, lights);
 			m_rightCam.renderLine(start, stop, lights);
 		}
+
+		void beginFrame() const override
+		{
+			m_leftCam.beginFrame();
+			m_rightCam.beginFrame();
+		}
+
+		void flush() const override
+		{
+			m_leftCam.flush();
+			m_rightCam.flush();
+		}
+
+		bool isVisible(const Renderable* object, const math::Affine& local) const override
+		{
+			return m_leftCam.isVisible(object, local) || m_rightCam.isVisible(object, local);
+		}
 	};
 }
 
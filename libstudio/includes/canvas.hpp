@@ -40,7 +40,16 @@ namespace studio
 	enum class Render
 	{
 		Wireframe,
-		Solid
+		Flat,    // lighting taken once per face
+		Gouraud, // lighting taken at the vertices and interpolated
+		Solid    // lighting taken for every pixel
+	};
+
+	// How the solid triangles are turned into pixels
+	enum class Raster
+	{
+		Scanline,  // sorted edges, one span per row
+		HalfSpace  // edge functions over 8x8 tiles
 	};
 
 	class Canvas
@@ -50,8 +59,15 @@ namespace studio
 		virtual void line(const math::Point& start, const math::Point& stop, const fixed& startDepth, const fixed& stopDepth) = 0;
 		virtual void text(const math::Point& pos, const wchar_t* _text, const fixed& depth) = 0;
 		virtual void flood(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3) = 0;
-		virtual void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, Shader* shader) = 0;
+		virtual void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, const ShaderPtr& shader) = 0;
+		// finishes all the fills still pending
+		virtual void flush() = 0;
 		virtual Render getRenderType() const = 0;
+		virtual int width() const = 0;
+		virtual int height() const = 0;
+		// true, if nothing at the nearest depth could be seen anywhere
+		// inside the rectangle
+		virtual bool isOccluded(const math::Point& lo, const math::Point& hi, const fixed& nearest) = 0;
 	};
 
 	struct StereoCanvas
@@ -60,8 +76,12 @@ namespace studio
 		virtual void line(const math::Point& start, const math::Point& stop, const fixed& startDepth, const fixed& stopDepth, bool leftEye) = 0;
 		virtual void text(const math::Point& pos, const wchar_t* _text, const fixed& depth, bool leftEye) = 0;
 		virtual void flood(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, bool leftEye) = 0;
-		virtual void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, Shader* shader, bool leftEye) = 0;
+		virtual void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, const ShaderPtr& shader, bool leftEye) = 0;
+		virtual void flush(bool leftEye) = 0;
 		virtual Render getRenderType(bool leftEye) const = 0;
+		virtual int width(bool leftEye) const = 0;
+		virtual int height(bool leftEye) const = 0;
+		virtual bool isOccluded(const math::Point& lo, const math::Point& hi, const fixed& nearest, bool leftEye) = 0;
 	};
 
 	class SingleEyeCanvas : public Canvas
@@ -90,15 +110,35 @@ namespace studio
 			m_ref->flood(p1, p2, p3, m_leftEye);
 		}
 
-		void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, Shader* shader) override
+		void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, const ShaderPtr& shader) override
 		{
 			m_ref->fill(p1, p2, p3, shader, m_leftEye);
 		}
 
+		void flush() override
+		{
+			m_ref->flush(m_leftEye);
+		}
+
 		Render getRenderType() const override
 		{
 			return m_ref->getRenderType(m_leftEye);
 		}
+
+		int width() const override
+		{
+			return m_ref->width(m_leftEye);
+		}
+
+		int height() const override
+		{
+			return m_ref->height(m_leftEye);
+		}
+
+		bool isOccluded(const math::Point& lo, const math::Point& hi, const fixed& nearest) override
+		{
+			return m_ref->isOccluded(lo, hi, nearest, m_leftEye);
+		}
 	};
 
 }
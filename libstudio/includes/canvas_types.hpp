@@ -65,21 +65,53 @@ namespace studio
 			(leftEye ? m_leftEye : m_rightEye).flood(p1, p2, p3);
 		}
 
-		void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, Shader* shader, bool leftEye) override
+		void fill(const PointWithDepth& p1, const PointWithDepth& p2, const PointWithDepth& p3, const ShaderPtr& shader, bool leftEye) override
 		{
 			(leftEye ? m_leftEye : m_rightEye).fill(p1, p2, p3, shader);
 		}
 
+		void flush(bool leftEye) override
+		{
+			(leftEye ? m_leftEye : m_rightEye).flush();
+		}
+
 		Render getRenderType(bool leftEye) const override
 		{
 			return (leftEye ? m_leftEye : m_rightEye).getRenderType();
 		}
 
+		int width(bool leftEye) const override
+		{
+			return (leftEye ? m_leftEye : m_rightEye).width();
+		}
+
+		int height(bool leftEye) const override
+		{
+			return (leftEye ? m_leftEye : m_rightEye).height();
+		}
+
+		bool isOccluded(const math::Point& lo, const math::Point& hi, const fixed& nearest, bool leftEye) override
+		{
+			return (leftEye ? m_leftEye : m_rightEye).isOccluded(lo, hi, nearest);
+		}
+
 		void setRenderType(Render renderType)
 		{
 			m_leftEye.setRenderType(renderType);
 			m_rightEye.setRenderType(renderType);
 		}
+
+		void setRasterType(Raster rasterType)
+		{
+			m_leftEye.setRasterType(rasterType);
+			m_rightEye.setRasterType(rasterType);
+		}
+
+		void setDeferred(bool deferred)
+		{
+			m_leftEye.setDeferred(deferred);
+			m_rightEye.setDeferred(deferred);
+		}
 	};
 
 	template <typename BasicBitmap = GrayscaleBitmap>
@@ -97,6 +129,16 @@ namespace studio
 			StereoCanvasImpl<BasicBitmap>::setRenderType(renderType);
 		}
 
+		void setRasterType(Raster rasterType)
+		{
+			StereoCanvasImpl<BasicBitmap>::setRasterType(rasterType);
+		}
+
+		void setDeferred(bool deferred)
+		{
+			StereoCanvasImpl<BasicBitmap>::setDeferred(deferred);
+		}
+
 		void save(const char* path)
 		{
 			int stride = this->stride();
@@ -161,6 +203,16 @@ namespace studio
 			StereoCanvasImpl<BasicBitmap>::setRenderType(renderType);
 		}
 
+		void setRasterType(Raster rasterType)
+		{
+			StereoCanvasImpl<BasicBitmap>::setRasterType(rasterType);
+		}
+
+		void setDeferred(bool deferred)
+		{
+			StereoCanvasImpl<BasicBitmap>::setDeferred(deferred);
+		}
+
 		void srcCopy(int x, int y, const BasicBitmap& eye)
 		{
 			int eyeX = 0;
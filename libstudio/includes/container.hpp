@@ -27,6 +27,8 @@
 
 #include "renderable.hpp"
 #include "shared_vector.hpp"
+#include "camera.hpp"
+#include <mutex>
 
 namespace studio
 {
@@ -35,23 +37,64 @@ namespace studio
 	protected:
 		typedef std::shared_vector<Renderable> Renderables;
 		Renderables m_children;
+
+	private:
+		// bounds() of the m_boundsRevision; several cameras may be asking
+		// at once
+		mutable Bounds m_bounds;
+		mutable unsigned m_boundsRevision;
+		mutable std::mutex m_boundsMutex;
+
+	protected:
+		// from now on, the child passes its touch() on to this container
+		void adopt(Renderable* child)
+		{
+			if (child)
+				child->m_parent = this;
+		}
+
 	public:
+		Container() : m_boundsRevision(0) {}
+
 		typedef Renderables::const_iterator const_iterator;
 
 		template <typename T, typename... Args>
 		std::shared_ptr<T> add(Args && ... args)
 		{
-			return m_children.emplace_back<T>(std::forward<Args>(args)...);
+			auto child = m_children.emplace_back<T>(std::forward<Args>(args)...);
+			adopt(child.get());
+			touch();
+			return child;
 		}
 
-		void renderTo(const ICamera* cam, const math::Matrix& parent, const Lights& lights) const override
+		void renderTo(const ICamera* cam, const math::Affine& parent, const Lights& lights) const override
 		{
-			math::Matrix accumulated = parent * localMatrix();
+			math::Affine accumulated = parent * localMatrix();
+			if (!cam->isVisible(this, accumulated))
+				return;
+
 			for (auto && child : m_children)
 				child->renderTo(cam, accumulated, lights);
 		}
 		MaterialPtr material() const { return nullptr; }
 
+		Bounds bounds() const override
+		{
+			// a new container has the revision 0 and no children, so the
+			// empty box is right from the start
+			auto current = revision();
+			std::lock_guard<std::mutex> lock(m_boundsMutex);
+			if (m_boundsRevision != current)
+			{
+				Bounds box;
+				for (auto && child : m_children)
+					box.add(child->bounds(), child->localMatrix());
+				m_bounds = box;
+				m_boundsRevision = current;
+			}
+			return m_bounds;
+		}
+
 		const_iterator begin() const { return m_children.begin(); }
 		const_iterator end() const { return m_children.end(); }
 	};
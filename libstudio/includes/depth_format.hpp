@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __LIBSTUDIO_DEPTH_FORMAT_HPP__
+#define __LIBSTUDIO_DEPTH_FORMAT_HPP__
+
+#include "fundamentals.hpp"
+
+namespace studio
+{
+	// View-space depth range mapped onto the integer formats. Anything
+	// outside is clamped to the nearest end.
+	struct DepthRange
+	{
+		fixed m_zNear;
+		fixed m_zFar;
+		double m_scale; // 1 / (far - near)
+
+		DepthRange(const fixed& zNear = -1024, const fixed& zFar = 16384)
+			: m_zNear(zNear)
+			, m_zFar(zFar)
+			, m_scale(1.0 / cast<double>(zFar - zNear))
+		{
+		}
+	};
+
+	// A depth format tells how the depth buffer stores a view-space z:
+	// encode/decode convert between the two, closer(a, b) is the depth
+	// test and clear() is the value of an empty pixel.
+
+	// the depth as computed, smaller is closer
+	struct depth_fixed
+	{
+		typedef fixed value_type;
+		static const char* name() { return "fixed"; }
+		static value_type clear() { return fixed::max(); }
+		static value_type encode(const fixed& z, const DepthRange&) { return z; }
+		static fixed decode(const value_type& v, const DepthRange&) { return v; }
+		static bool closer(const value_type& lhs, const value_type& rhs) { return lhs < rhs; }
+	};
+
+	// 32-bit float, smaller is closer
+	struct depth_float32
+	{
+		typedef float value_type;
+		static const char* name() { return "float32"; }
+		static value_type clear() { return std::numeric_limits<float>::max(); }
+		static value_type encode(const fixed& z, const DepthRange&) { return cast<float>(z); }
+		static fixed decode(value_type v, const DepthRange&) { return v == clear() ? fixed::max() : fixed(v); }
+		static bool closer(value_type lhs, value_type rhs) { return lhs < rhs; }
+	};
+
+	// Linear reversed-Z in an unsigned integer: the near plane is the
+	// largest value and an empty pixel is 0, so the clear value is the
+	// same for all the bit depths and the compare is a plain integer
+	// compare.
+	template <int Bits>
+	struct depth_reversed
+	{
+		typedef u32 value_type;
+		static const char* name() { return Bits == 24 ? "uint24" : "uint32"; }
+		static value_type clear() { return 0; }
+		static double top() { return (double) (Bits < 32 ? (1u << Bits) - 1 : 0xFFFFFFFFu); }
+
+		static value_type encode(const fixed& z, const DepthRange& range)
+		{
+			auto t = cast<double>(range.m_zFar - z) * range.m_scale;
+			if (t <= 0) return 1; // farthest, but still not empty
+			if (t >= 1) return (value_type) top();
+			return (value_type) (t * top() + 0.5);
+		}
+
+		static fixed decode(value_type v, const DepthRange& range)
+		{
+			if (v == clear())
+				return fixed::max();
+			return range.m_zFar - fixed(v / top() / range.m_scale);
+		}
+
+		static bool closer(value_type lhs, value_type rhs) { return lhs > rhs; }
+	};
+
+	typedef depth_reversed<24> depth_uint24;
+	typedef depth_reversed<32> depth_uint32;
+
+	// Compile-time choice of the depth buffer format, same as with the
+	// fixed policy.
+#if !defined(STUDIO_DEPTH_FIXED) && !defined(STUDIO_DEPTH_FLOAT32) && !defined(STUDIO_DEPTH_UINT24) && !defined(STUDIO_DEPTH_UINT32)
+#define STUDIO_DEPTH_FLOAT32
+#endif
+
+#if defined(STUDIO_DEPTH_FIXED)
+	typedef depth_fixed depth_format;
+#elif defined(STUDIO_DEPTH_FLOAT32)
+	typedef depth_float32 depth_format;
+#elif defined(STUDIO_DEPTH_UINT24)
+	typedef depth_uint24 depth_format;
+#else
+	typedef depth_uint32 depth_format;
+#endif
+}
+
+#endif //__LIBSTUDIO_DEPTH_FORMAT_HPP__
\ No newline at end of file
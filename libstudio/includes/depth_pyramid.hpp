@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __LIBSTUDIO_DEPTH_PYRAMID_HPP__
+#define __LIBSTUDIO_DEPTH_PYRAMID_HPP__
+
+#include "fundamentals.hpp"
+#include <vector>
+#include <algorithm>
+
+namespace studio
+{
+	// Min/max mip chain of a depth buffer. Every texel of the level k
+	// keeps the nearest and the farthest depth of a 2^k x 2^k block of
+	// pixels, so a question about a whole block of the depth buffer is
+	// answered by a single texel.
+	class DepthPyramid
+	{
+		struct Level
+		{
+			int width;
+			int height;
+			std::vector<fixed> nearest;
+			std::vector<fixed> farthest;
+		};
+		std::vector<Level> m_levels;
+
+	public:
+		template <typename Depth>
+		DepthPyramid(int width, int height, const Depth& depth)
+		{
+			m_levels.push_back({ width, height });
+			auto && base = m_levels.back();
+			base.nearest.resize(width * height);
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+					base.nearest[y * width + x] = depth(x, y);
+			}
+			base.farthest = base.nearest;
+
+			while (width > 1 || height > 1)
+			{
+				width = (width + 1) / 2;
+				height = (height + 1) / 2;
+				m_levels.push_back({ width, height });
+				auto && prev = m_levels[m_levels.size() - 2];
+				auto && next = m_levels.back();
+				next.nearest.resize(width * height);
+				next.farthest.resize(width * height);
+				for (int y = 0; y < height; ++y)
+				{
+					int y0 = y * 2, y1 = std::min(y0 + 1, prev.height - 1);
+					for (int x = 0; x < width; ++x)
+					{
+						int x0 = x * 2, x1 = std::min(x0 + 1, prev.width - 1);
+						int src[] = { y0 * prev.width + x0, y0 * prev.width + x1, y1 * prev.width + x0, y1 * prev.width + x1 };
+						auto lo = prev.nearest[src[0]];
+						auto hi = prev.farthest[src[0]];
+						for (int i = 1; i < 4; ++i)
+						{
+							lo = std::min(lo, prev.nearest[src[i]]);
+							hi = std::max(hi, prev.farthest[src[i]]);
+						}
+						next.nearest[y * width + x] = lo;
+						next.farthest[y * width + x] = hi;
+					}
+				}
+			}
+		}
+
+		int levels() const { return (int) m_levels.size(); }
+
+		// Nearest and farthest depth of the pixels between (x0, y0) and
+		// (x1, y1), inclusive, read from the level given. The rectangle
+		// should not be wider or higher than 2^level, or it touches more
+		// than the 2x2 texels it is meant to.
+		void bounds(int level, int x0, int y0, int x1, int y1, fixed& nearest, fixed& farthest) const
+		{
+			auto && lvl = m_levels[level];
+			x0 >>= level; x1 >>= level;
+			y0 >>= level; y1 >>= level;
+			nearest = fixed::max();
+			farthest = fixed::lowest();
+			for (int y = y0; y <= y1; ++y)
+			{
+				for (int x = x0; x <= x1; ++x)
+				{
+					nearest = std::min(nearest, lvl.nearest[y * lvl.width + x]);
+					farthest = std::max(farthest, lvl.farthest[y * lvl.width + x]);
+				}
+			}
+		}
+	};
+}
+
+#endif //__LIBSTUDIO_DEPTH_PYRAMID_HPP__
\ No newline at end of file
@@ -28,6 +28,8 @@
 #include <cmath>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <type_traits>
 
 namespace studio
 {
@@ -44,338 +46,238 @@ namespace studio
 	namespace math
 	{
 		static const long double PI = 3.14159265358979323846264338327950288419716939937510L;
-#if 1
-#define PROXY_OP_M(op) \
-	fixed& operator op(const fixed& rhs) { v op rhs.v; return *this; } \
-	fixed& operator op(long double rhs) { v op rhs; return *this; } \
-	fixed& operator op(double rhs) { v op rhs; return *this; } \
-	fixed& operator op(float rhs) { v op rhs; return *this; } \
-	fixed& operator op(long long rhs) { v op rhs; return *this; } \
-	fixed& operator op(long rhs) { v op rhs; return *this; } \
-	fixed& operator op(int rhs) { v op rhs; return *this; } \
-	fixed& operator op(unsigned long long rhs) { v op rhs; return *this; } \
-	fixed& operator op(unsigned long rhs) { v op rhs; return *this; } \
-	fixed& operator op(unsigned int rhs) { v op rhs; return *this; }
-#define PROXY_OP_HELPER(op, type) \
-	inline fixed operator op(type lhs, const fixed& rhs) { return fixed(lhs op rhs.v); } \
-	inline fixed operator op(const fixed& lhs, type rhs) { return fixed(lhs.v op rhs); }
-
-#define PROXY_OP(op) \
-	inline fixed operator op(const fixed& lhs, const fixed& rhs) { return fixed(lhs.v op rhs.v); } \
-	PROXY_OP_HELPER(op, long double) \
-	PROXY_OP_HELPER(op, double) \
-	PROXY_OP_HELPER(op, float) \
-	PROXY_OP_HELPER(op, long long) \
-	PROXY_OP_HELPER(op, long) \
-	PROXY_OP_HELPER(op, int) \
-	PROXY_OP_HELPER(op, unsigned long long) \
-	PROXY_OP_HELPER(op, unsigned long) \
-	PROXY_OP_HELPER(op, unsigned int)
-
-#define PROXY_OP_UNARY(op) inline fixed operator op () const { return fixed(-v); }
-#define PROXY_CMP_HELPER(op, type) \
-	inline bool operator op(type lhs, const fixed& rhs) { return lhs op rhs.v; } \
-	inline bool operator op(const fixed& lhs, type rhs) { return lhs.v op rhs; }
-#define PROXY_CMP(op) \
-	inline bool operator op(const fixed& lhs, const fixed& rhs) { return lhs.v op rhs.v; } \
-	PROXY_CMP_HELPER(op, long double) \
-	PROXY_CMP_HELPER(op, double) \
-	PROXY_CMP_HELPER(op, float) \
-	PROXY_CMP_HELPER(op, long int) \
-	PROXY_CMP_HELPER(op, int)
-
-		struct fixed
+
+		// Scalar policies for the fixed type. Each policy knows how to
+		// store a value and how to do the arithmetic on the stored value;
+		// the rest of the engine only ever sees fixed.
+
+		template <typename T>
+		struct float_policy
 		{
-			inline fixed __abs() const
-			{
-				if (v < 0) return -*this;
-				return *this;
-			}
+			typedef T value_type;
 
-			long double v;
-			fixed(): v(0) {}
-			fixed(fixed && rhs) : v(rhs.v) { }
-			fixed(long long v) : v((decltype(this->v)) v) {}
-			fixed(int v) : v(v) {}
-			fixed(unsigned long long v) : v((decltype(this->v)) v) {}
-			fixed(unsigned int v) : v(v) {}
-
-			explicit fixed(long double v) : v(v) {}
-			explicit fixed(double v) : v(v) {}
-			explicit fixed(float v) : v(v) {}
-
-			fixed& operator = (fixed && rhs) { v = rhs.v; return *this; }
-			fixed& operator = (const fixed& rhs) { v = rhs.v; return *this; }
-			fixed& operator = (long long rhs) { v = (decltype(this->v)) rhs; return *this; }
-			fixed& operator = (int rhs) { v = rhs; return *this; }
-			fixed& operator = (unsigned long long rhs) { v = (decltype(this->v)) rhs; return *this; }
-			fixed& operator = (unsigned int rhs) { v = rhs; return *this; }
-
-			PROXY_OP_M( += );
-			PROXY_OP_M( -= );
-			PROXY_OP_M( *= );
-			PROXY_OP_M( /= );
-			PROXY_OP_UNARY(-);
-			PROXY_OP_UNARY(+);
-			bool operator ! () const { return __abs().v < 0.00001; }
-		private:
-		};
+			static const char* name() { return sizeof(T) == sizeof(float) ? "float" : "double"; }
 
-		PROXY_CMP( == );
-		PROXY_CMP( != );
-		PROXY_CMP( <  );
-		PROXY_CMP( >  );
-		PROXY_CMP( <= );
-		PROXY_CMP( >= );
+			static value_type from(long double v) { return (value_type) v; }
+			static value_type from(long long v) { return (value_type) v; }
+			static value_type from(unsigned long long v) { return (value_type) v; }
 
-		PROXY_OP( + );
-		PROXY_OP( - );
-		PROXY_OP( * );
-		PROXY_OP( / );
+			template <typename I>
+			static I to(value_type v) { return (I) v; }
 
-		inline fixed __abs(const fixed& ld)
-		{
-			return ld.__abs();
-		}
+			static value_type add(value_type lhs, value_type rhs) { return lhs + rhs; }
+			static value_type sub(value_type lhs, value_type rhs) { return lhs - rhs; }
+			static value_type mul(value_type lhs, value_type rhs) { return lhs * rhs; }
+			static value_type div(value_type lhs, value_type rhs) { return lhs / rhs; }
+			static value_type neg(value_type v) { return -v; }
+			static bool is_zero(value_type v) { return (v < 0 ? -v : v) < (value_type) 0.00001; }
 
-		inline fixed sin(const fixed& v) { return fixed(std::sin(v.v)); }
-		inline fixed cos(const fixed& v) { return fixed(std::cos(v.v)); }
-		inline fixed sqrt(const fixed& v) { return fixed(std::sqrt(v.v)); }
+			static value_type max() { return std::numeric_limits<value_type>::max(); }
+			static value_type lowest() { return -std::numeric_limits<value_type>::max(); }
 
-		template <typename T>
-		inline T cast(const fixed& v) { return (T)v.v; }
-#else
-#define PROXY_OP_M(op) \
-	fixed& operator op(long double rhs) { return *this op fixed(rhs); } \
-	fixed& operator op(double rhs) { return *this op fixed(rhs); } \
-	fixed& operator op(float rhs) { return *this op fixed(rhs); } \
-	fixed& operator op(long long rhs) { return *this op fixed(rhs); } \
-	fixed& operator op(long rhs) { return *this op fixed(rhs); } \
-	fixed& operator op(int rhs) { return *this op fixed(rhs); } \
-	fixed& operator op(unsigned long long rhs) { return *this op fixed(rhs); } \
-	fixed& operator op(unsigned long rhs) { return *this op fixed((unsigned long long)rhs); } \
-	fixed& operator op(unsigned int rhs) { return *this op fixed(rhs); }
-
-#define PROXY_CMP_HELPER(op, type) \
-	inline bool operator op(type lhs, const fixed& rhs) { return fixed(lhs).v op rhs.v; } \
-	inline bool operator op(const fixed& lhs, type rhs) { return lhs.v op fixed(rhs).v; }
-#define PROXY_CMP(op) \
-	inline bool operator op(const fixed& lhs, const fixed& rhs) { return lhs.v op rhs.v; } \
-	PROXY_CMP_HELPER(op, long double) \
-	PROXY_CMP_HELPER(op, double) \
-	PROXY_CMP_HELPER(op, float) \
-	PROXY_CMP_HELPER(op, long int) \
-	PROXY_CMP_HELPER(op, int)
-
-#define PROXY_OP_HELPER(op, type) \
-	inline fixed operator op(type lhs, const fixed& rhs) { return fixed(lhs) op rhs; } \
-	inline fixed operator op(const fixed& lhs, type rhs) { return lhs op fixed(rhs); }
-
-#define PROXY_OP(op) \
-	PROXY_OP_HELPER(op, long double) \
-	PROXY_OP_HELPER(op, double) \
-	PROXY_OP_HELPER(op, float) \
-	PROXY_OP_HELPER(op, long long) \
-	PROXY_OP_HELPER(op, long) \
-	PROXY_OP_HELPER(op, int) \
-	PROXY_OP_HELPER(op, unsigned long long) \
-	inline fixed operator op(unsigned long lhs, const fixed& rhs) { return fixed((unsigned long long)lhs) op rhs; } \
-	inline fixed operator op(const fixed& lhs, unsigned long rhs) { return lhs op fixed((unsigned long long)rhs); } \
-	PROXY_OP_HELPER(op, unsigned int)
-
-		struct fixed
+			static value_type sqrt(value_type v) { return std::sqrt(v); }
+			static value_type sin(value_type v) { return std::sin(v); }
+			static value_type cos(value_type v) { return std::cos(v); }
+		};
+
+		// Q16.16 stored in 32 bits. All the operations go through 64-bit
+		// intermediates and saturate at the range limits instead of
+		// wrapping around, so an overflow shows up as a clamped value and
+		// not as a sign flip somewhere in the middle of the frame.
+		struct q16_policy
 		{
-			enum { BITS = 8, DENOM = 1 << BITS };
-			long long v;
+			typedef i32 value_type;
+			enum { BITS = 16, ONE = 1 << BITS };
 
-			static long long conv(long long v)
+			static const char* name() { return "q16.16"; }
+
+			static value_type saturate(i64 v)
 			{
-				auto neg = v < 0;
-				if (neg) v = -v;
-				v = v << BITS;
-				if (neg) v = -v;
-				return v;
-			}
-			static long long conv(int v)  { return conv((long long) v); }
-			static long long conv(unsigned long long v) { return (0x7FFFFFFFFFFFFFFFull & (v << BITS)); }
-			static long long conv(unsigned int v) { return v << BITS; }
-			static long long conv(long double v)
-			{
-				v *= DENOM;
-				v += 0.5;
-				return (long long) v;
+				if (v > std::numeric_limits<value_type>::max()) return std::numeric_limits<value_type>::max();
+				if (v < std::numeric_limits<value_type>::min()) return std::numeric_limits<value_type>::min();
+				return (value_type) v;
 			}
 
-			static long long conv(double v)
+			static value_type from(long double v)
 			{
-				v *= DENOM;
-				v += 0.5;
-				return (long long) v;
+				v *= ONE;
+				if (v >= std::numeric_limits<value_type>::max()) return std::numeric_limits<value_type>::max();
+				if (v <= std::numeric_limits<value_type>::min()) return std::numeric_limits<value_type>::min();
+				return (value_type) (v < 0 ? v - 0.5 : v + 0.5);
 			}
-
-			static long long conv(float v)
+			static value_type from(long long v)
 			{
-				v *= DENOM;
-				v += 0.5;
-				return (long long) v;
+				if (v > (std::numeric_limits<value_type>::max() >> BITS)) return std::numeric_limits<value_type>::max();
+				if (v < (std::numeric_limits<value_type>::min() >> BITS)) return std::numeric_limits<value_type>::min();
+				return (value_type) (v * ONE);
 			}
-
-			fixed() : v(0) {}
-			fixed(fixed && rhs) : v(rhs.v){}
-			fixed(const fixed & rhs) : v(rhs.v){}
-			fixed(long long v) : v(conv(v)) {}
-			fixed(int v) : v(conv(v)) {}
-			fixed(unsigned long long v) : v(conv(v)) {}
-			fixed(unsigned int v) : v(conv(v)) {}
-
-			explicit fixed(long double v) : v(conv(v)) {}
-			explicit fixed(double v) : v(conv(v)) {}
-			explicit fixed(float v) : v(conv(v)) {}
-
-			static fixed fromValue(long long v)
+			static value_type from(unsigned long long v)
 			{
-				fixed ret;
-				ret.v = v;
-				return ret;
+				if (v > (unsigned long long) (std::numeric_limits<value_type>::max() >> BITS)) return std::numeric_limits<value_type>::max();
+				return (value_type) (v * ONE);
 			}
 
-			fixed& operator = (fixed && rhs) { v = rhs.v; return *this; }
-			fixed& operator = (const fixed& rhs) { v = rhs.v; return *this; }
-			fixed& operator = (long long rhs) { v = conv(rhs); return *this; }
-			fixed& operator = (int rhs) { v = conv(rhs); return *this; }
-			fixed& operator = (unsigned long long rhs) { v = conv(rhs); return *this; }
-			fixed& operator = (unsigned int rhs) { v = conv(rhs); return *this; }
-#if 1
-			fixed& operator += (const fixed& rhs) { v += rhs.v; return *this; }
-			fixed& operator -= (const fixed& rhs) { v -= rhs.v; return *this; }
-			fixed& operator *= (const fixed& rhs) { v *= rhs.v; v /= DENOM; return *this; }
-			fixed& operator /= (const fixed& rhs) { v *= DENOM; v /= rhs.v; return *this; }
-#else
-			fixed& operator += (const fixed& rhs)
+			template <typename I>
+			static I to(value_type v) { return to<I>(v, std::is_floating_point<I>()); }
+			template <typename I>
+			static I to(value_type v, std::true_type) { return (I) v / ONE; }
+			template <typename I>
+			static I to(value_type v, std::false_type) { return (I) (v / ONE); }
+
+			static value_type add(value_type lhs, value_type rhs) { return saturate((i64) lhs + rhs); }
+			static value_type sub(value_type lhs, value_type rhs) { return saturate((i64) lhs - rhs); }
+			static value_type mul(value_type lhs, value_type rhs) { return saturate(((i64) lhs * rhs) >> BITS); }
+			static value_type div(value_type lhs, value_type rhs)
 			{
-				auto tmp = v;
-				v += rhs.v;
-
-				auto t1 = (float) tmp / DENOM;
-				auto v1 = (float) v / DENOM;
-				auto r1 = (float) rhs.v / DENOM;
-				if (t1 + r1 != v1)
-					std::cout << "!" << std::flush;
-				return *this;
+				if (!rhs)
+					return lhs < 0 ? std::numeric_limits<value_type>::min() : std::numeric_limits<value_type>::max();
+				return saturate(((i64) lhs << BITS) / rhs);
 			}
-			fixed& operator -= (const fixed& rhs)
-			{
-				auto tmp = v;
-				v += rhs.v;
+			static value_type neg(value_type v) { return saturate(-(i64) v); }
+			static bool is_zero(value_type v) { return v == 0; }
 
-				auto t1 = (float) tmp / DENOM;
-				auto v1 = (float) v / DENOM;
-				auto r1 = (float) rhs.v / DENOM;
-				if (t1 - r1 != v1)
-					std::cout << "!" << std::flush;
-				return *this;
-			}
-			fixed& operator *= (const fixed& rhs)
-			{
-				auto tmp = v;
-				v += rhs.v;
+			static value_type max() { return std::numeric_limits<value_type>::max(); }
+			static value_type lowest() { return -std::numeric_limits<value_type>::max(); }
 
-				auto t1 = (float) tmp / DENOM;
-				auto v1 = (float) v / DENOM;
-				auto r1 = (float) rhs.v / DENOM;
-				if (t1 * r1 != v1)
-					std::cout << "!" << std::flush;
-				return *this;
-			}
-			fixed& operator /= (const fixed& rhs)
-			{
-				auto tmp = v;
-				v += rhs.v;
+			static value_type sqrt(value_type v) { return from((long double) std::sqrt(to<double>(v))); }
+			static value_type sin(value_type v) { return from((long double) std::sin(to<double>(v))); }
+			static value_type cos(value_type v) { return from((long double) std::cos(to<double>(v))); }
+		};
 
-				auto t1 = (float) tmp / DENOM;
-				auto v1 = (float) v / DENOM;
-				auto r1 = (float) rhs.v / DENOM;
-				if (t1 / r1 != v1)
-					std::cout << "!" << std::flush;
-				return *this;
-			}
-#endif
+#define PROXY_OP_M(op, fn) \
+	basic_fixed& operator op(const basic_fixed& rhs) { v = Policy::fn(v, rhs.v); return *this; } \
+	basic_fixed& operator op(long double rhs) { return *this op basic_fixed(rhs); } \
+	basic_fixed& operator op(double rhs) { return *this op basic_fixed(rhs); } \
+	basic_fixed& operator op(float rhs) { return *this op basic_fixed(rhs); } \
+	basic_fixed& operator op(long long rhs) { return *this op basic_fixed(rhs); } \
+	basic_fixed& operator op(long rhs) { return *this op basic_fixed((long long) rhs); } \
+	basic_fixed& operator op(int rhs) { return *this op basic_fixed(rhs); } \
+	basic_fixed& operator op(unsigned long long rhs) { return *this op basic_fixed(rhs); } \
+	basic_fixed& operator op(unsigned long rhs) { return *this op basic_fixed((unsigned long long) rhs); } \
+	basic_fixed& operator op(unsigned int rhs) { return *this op basic_fixed(rhs); }
+
+#define PROXY_OP_HELPER(op, type, conv) \
+	friend basic_fixed operator op(type lhs, const basic_fixed& rhs) { return basic_fixed((conv) lhs) op rhs; } \
+	friend basic_fixed operator op(const basic_fixed& lhs, type rhs) { return lhs op basic_fixed((conv) rhs); }
+
+#define PROXY_OP(op, fn) \
+	friend basic_fixed operator op(const basic_fixed& lhs, const basic_fixed& rhs) { return fromValue(Policy::fn(lhs.v, rhs.v)); } \
+	PROXY_OP_HELPER(op, long double, long double) \
+	PROXY_OP_HELPER(op, double, double) \
+	PROXY_OP_HELPER(op, float, float) \
+	PROXY_OP_HELPER(op, long long, long long) \
+	PROXY_OP_HELPER(op, long, long long) \
+	PROXY_OP_HELPER(op, int, int) \
+	PROXY_OP_HELPER(op, unsigned long long, unsigned long long) \
+	PROXY_OP_HELPER(op, unsigned long, unsigned long long) \
+	PROXY_OP_HELPER(op, unsigned int, unsigned int)
+
+#define PROXY_CMP_HELPER(op, type, conv) \
+	friend bool operator op(type lhs, const basic_fixed& rhs) { return basic_fixed((conv) lhs).v op rhs.v; } \
+	friend bool operator op(const basic_fixed& lhs, type rhs) { return lhs.v op basic_fixed((conv) rhs).v; }
+#define PROXY_CMP(op) \
+	friend bool operator op(const basic_fixed& lhs, const basic_fixed& rhs) { return lhs.v op rhs.v; } \
+	PROXY_CMP_HELPER(op, long double, long double) \
+	PROXY_CMP_HELPER(op, double, double) \
+	PROXY_CMP_HELPER(op, float, float) \
+	PROXY_CMP_HELPER(op, long int, long long) \
+	PROXY_CMP_HELPER(op, int, int)
+
+		template <typename Policy>
+		struct basic_fixed
+		{
+			typedef Policy policy_type;
+			typedef typename Policy::value_type value_type;
+
+			value_type v;
 
-			PROXY_OP_M(+= );
-			PROXY_OP_M(-= );
-			PROXY_OP_M(*= );
-			PROXY_OP_M(/= );
+			basic_fixed() : v(0) {}
+			basic_fixed(const basic_fixed& rhs) : v(rhs.v) {}
+			basic_fixed(long long v) : v(Policy::from(v)) {}
+			basic_fixed(int v) : v(Policy::from((long long) v)) {}
+			basic_fixed(unsigned long long v) : v(Policy::from(v)) {}
+			basic_fixed(unsigned int v) : v(Policy::from((unsigned long long) v)) {}
 
-			inline fixed operator -() const { return fromValue(-v); }
-			inline fixed operator +() const { return fromValue(+v); }
-			inline bool operator !() const { return v == 0; }
+			explicit basic_fixed(long double v) : v(Policy::from(v)) {}
+			explicit basic_fixed(double v) : v(Policy::from((long double) v)) {}
+			explicit basic_fixed(float v) : v(Policy::from((long double) v)) {}
 
-			inline long long ipart() const { return v / DENOM; }
+			static basic_fixed fromValue(value_type v)
+			{
+				basic_fixed ret;
+				ret.v = v;
+				return ret;
+			}
+
+			static basic_fixed max() { return fromValue(Policy::max()); }
+			static basic_fixed lowest() { return fromValue(Policy::lowest()); }
+
+			basic_fixed& operator = (const basic_fixed& rhs) { v = rhs.v; return *this; }
+			basic_fixed& operator = (long long rhs) { v = Policy::from(rhs); return *this; }
+			basic_fixed& operator = (int rhs) { v = Policy::from((long long) rhs); return *this; }
+			basic_fixed& operator = (unsigned long long rhs) { v = Policy::from(rhs); return *this; }
+			basic_fixed& operator = (unsigned int rhs) { v = Policy::from((unsigned long long) rhs); return *this; }
+
+			PROXY_OP_M(+=, add);
+			PROXY_OP_M(-=, sub);
+			PROXY_OP_M(*=, mul);
+			PROXY_OP_M(/=, div);
+
+			basic_fixed operator -() const { return fromValue(Policy::neg(v)); }
+			basic_fixed operator +() const { return *this; }
+			bool operator !() const { return Policy::is_zero(v); }
+
+			PROXY_CMP(==);
+			PROXY_CMP(!=);
+			PROXY_CMP(<);
+			PROXY_CMP(>);
+			PROXY_CMP(<=);
+			PROXY_CMP(>=);
+
+			PROXY_OP(+, add);
+			PROXY_OP(-, sub);
+			PROXY_OP(*, mul);
+			PROXY_OP(/, div);
 		};
 
-		PROXY_CMP(== );
-		PROXY_CMP(!= );
-		PROXY_CMP(<);
-		PROXY_CMP(>);
-		PROXY_CMP(<= );
-		PROXY_CMP(>= );
-
-#if 1
-		inline fixed operator + (const fixed& lhs, const fixed& rhs) { return fixed::fromValue(lhs.v + rhs.v); }
-		inline fixed operator - (const fixed& lhs, const fixed& rhs) { return fixed::fromValue(lhs.v - rhs.v); }
-		inline fixed operator * (const fixed& lhs, const fixed& rhs) { return fixed::fromValue((lhs.v * rhs.v) / fixed::DENOM); }
-		inline fixed operator / (const fixed& lhs, const fixed& rhs) { return fixed::fromValue((lhs.v * fixed::DENOM) / rhs.v); }
-#else
-		inline fixed operator + (const fixed& lhs, const fixed& rhs)
-		{
-			auto ret = v;
-			v += rhs.v;
-
-			auto t1 = (float) tmp / DENOM;
-			auto v1 = (float) v / DENOM;
-			auto r1 = (float) rhs.v / DENOM;
-			if (t1 + r1 != v1)
-				std::cout << "!" << std::flush;
-			return ret;
-		}
-		inline fixed operator - (const fixed& lhs, const fixed& rhs) { return fixed(lhs.v - rhs.v); }
-		inline fixed operator * (const fixed& lhs, const fixed& rhs) { return fixed((lhs.v * rhs.v) / fixed::DENOM); }
-		inline fixed operator / (const fixed& lhs, const fixed& rhs) { return fixed((lhs.v * fixed::DENOM) / rhs.v); }
-#endif
-		PROXY_OP(+);
-		PROXY_OP(-);
-		PROXY_OP(*);
-		PROXY_OP(/ );
+#undef PROXY_CMP
+#undef PROXY_CMP_HELPER
+#undef PROXY_OP
+#undef PROXY_OP_HELPER
+#undef PROXY_OP_M
 
-		inline fixed __abs(const fixed& ld)
+		template <typename Policy>
+		inline basic_fixed<Policy> __abs(const basic_fixed<Policy>& ld)
 		{
 			if (ld < 0) return -ld;
 			return ld;
 		}
 
-		template <class T> struct caster;
-#define FLOAT_CAST(T) template <> struct caster<T> { static T cast(const fixed& v) { return ((T)v.v) / fixed::DENOM; } }
-#define INT_CAST(T) template <> struct caster<T> { static T cast(const fixed& v) { return (T) v.ipart(); } }
-
-		FLOAT_CAST(long double);
-		FLOAT_CAST(double);
-		FLOAT_CAST(float);
-		INT_CAST(long long);
-		INT_CAST(long);
-		INT_CAST(int);
-		INT_CAST(char);
-		INT_CAST(unsigned long long);
-		INT_CAST(unsigned long);
-		INT_CAST(unsigned int);
-		INT_CAST(unsigned char);
-
-		template <typename T>
-		inline T cast(const fixed& v) { return caster<T>::cast(v); }
+		template <typename Policy>
+		inline basic_fixed<Policy> sin(const basic_fixed<Policy>& v) { return basic_fixed<Policy>::fromValue(Policy::sin(v.v)); }
+		template <typename Policy>
+		inline basic_fixed<Policy> cos(const basic_fixed<Policy>& v) { return basic_fixed<Policy>::fromValue(Policy::cos(v.v)); }
+		template <typename Policy>
+		inline basic_fixed<Policy> sqrt(const basic_fixed<Policy>& v) { return basic_fixed<Policy>::fromValue(Policy::sqrt(v.v)); }
+
+		template <typename T, typename Policy>
+		inline T cast(const basic_fixed<Policy>& v) { return Policy::template to<T>(v.v); }
+
+		// The scalar used everywhere in the engine. Select it at build
+		// time with STUDIO_FIXED_FLOAT, STUDIO_FIXED_DOUBLE or
+		// STUDIO_FIXED_Q16; float is used, when nothing is selected.
+#if !defined(STUDIO_FIXED_FLOAT) && !defined(STUDIO_FIXED_DOUBLE) && !defined(STUDIO_FIXED_Q16)
+#define STUDIO_FIXED_FLOAT
+#endif
 
-		inline fixed sin(const fixed& v) { return fixed(std::sin(cast<double>(v))); }
-		inline fixed cos(const fixed& v) { return fixed(std::cos(cast<double>(v))); }
-		inline fixed sqrt(const fixed& v) { return fixed(std::sqrt(cast<double>(v))); }
+#if defined(STUDIO_FIXED_Q16)
+		typedef q16_policy fixed_policy;
+#elif defined(STUDIO_FIXED_DOUBLE)
+		typedef float_policy<double> fixed_policy;
+#else
+		typedef float_policy<float> fixed_policy;
 #endif
+		typedef basic_fixed<fixed_policy> fixed;
 
 		template <size_t width, size_t height>
 		class MatrixBase
@@ -390,6 +292,8 @@ namespace studio
 			};
 			fixed at(size_t x, size_t y) const { return m_data[x + y * width]; }
 			fixed& at(size_t x, size_t y) { return m_data[x + y * width]; }
+			const fixed* data() const { return m_data; }
+			fixed* data() { return m_data; }
 		};
 
 #define MATRIX_OPS(Type) \
@@ -434,6 +338,9 @@ namespace studio
 	my_t& set_ ## name(const fixed& val) { m_data[pos] = val; return *this; }
 
 
+		class Vertex;
+		class Vector;
+
 		class Matrix : public MatrixBase<4, 4>
 		{
 		public:
@@ -456,20 +363,20 @@ namespace studio
 				auto _sy = sy;
 				auto _sz = sz;
 				if (__abs(sy) < fixed(0.00001)) _sy = sx;
-				if (__abs(sz) < fixed(0.00001)) _sz = sy;
+				if (__abs(sz) < fixed(0.00001)) _sz = _sy;
 				return Matrix().set_at(0, 0, sx).set_at(1, 1, _sy).set_at(2, 2, _sz);
 			}
 			static Matrix rotateX(const fixed& theta)
 			{
 				fixed cosTheta = cos(theta);
 				fixed sinTheta = sin(theta);
-				return Matrix().set_at(2, 2, cosTheta).set_at(3, 2, -sinTheta).set_at(2, 3, sinTheta).set_at(3, 3, cosTheta);
+				return Matrix().set_at(1, 1, cosTheta).set_at(2, 1, -sinTheta).set_at(1, 2, sinTheta).set_at(2, 2, cosTheta);
 			}
 			static Matrix rotateY(const fixed& theta)
 			{
 				fixed cosTheta = cos(theta);
 				fixed sinTheta = sin(theta);
-				return Matrix().set_at(0, 0, cosTheta).set_at(3, 0, sinTheta).set_at(0, 3, -sinTheta).set_at(3, 3, cosTheta);
+				return Matrix().set_at(0, 0, cosTheta).set_at(2, 0, sinTheta).set_at(0, 2, -sinTheta).set_at(2, 2, cosTheta);
 			}
 			static Matrix rotateZ(const fixed& theta)
 			{
@@ -486,28 +393,13 @@ namespace studio
 				return true;
 			}
 
+			// out = lhs * rhs; out may be the same object as lhs or rhs
+			static void multiply(const Matrix& lhs, const Matrix& rhs, Matrix& out);
 
-			template <typename T>
-			T multiply(const T& rhs) const
-			{
-				static_assert(my_width == T::my_height, "Only matrices of height 4 allowed");
-				if (is_identity())
-					return rhs;
-
-				T out;
-				for (size_t w = 0; w < T::my_width; ++w)
-				{
-					for (size_t h = 0; h < T::my_height; ++h)
-					{
-						out.at(w, h) = fixed();
-						for (size_t c = 0; c < my_width; ++c)
-						{
-							out.at(w, h) += at(c, h) * rhs.at(w, c);
-						}
-					}
-				}
-				return out;
-			}
+			// out[i] = *this * in[i] for the whole array in one call; in and
+			// out may point to the same array
+			void transform(const Vertex* in, Vertex* out, size_t count) const;
+			void transform(const Vector* in, Vector* out, size_t count) const;
 		};
 
 		class Point
@@ -596,6 +488,99 @@ namespace studio
 			static fixed cosTheta(const Vector& lhs, const Vector& rhs);
 		};
 
+		// 3x4 affine transform: a Matrix, which last row is always
+		// [0 0 0 1], so it is not stored. Every operation keeps track of
+		// the kind of the transform, so composition and vertex transform
+		// can take the cheap path without looking at the elements.
+		class Affine
+		{
+		public:
+			enum Kind
+			{
+				Identity,
+				Translation,
+				General
+			};
+
+			enum
+			{
+				my_width = 4,
+				my_height = 3
+			};
+
+			Affine()
+				: m_kind(Identity)
+			{
+				for (size_t i = 0; i < sizeof(m_data) / sizeof(m_data[0]); ++i)
+					m_data[i] = i % 5 ? 0 : 1;
+			}
+
+			static Affine identity() { return Affine(); }
+			static Affine translate(const fixed& dx, const fixed& dy = fixed(), const fixed& dz = fixed())
+			{
+				Affine out;
+				out.m_data[3] = dx;
+				out.m_data[7] = dy;
+				out.m_data[11] = dz;
+				out.m_kind = dx == 0 && dy == 0 && dz == 0 ? Identity : Translation;
+				return out;
+			}
+			static Affine scale(const fixed& sx, const fixed& sy = fixed(), const fixed& sz = fixed())
+			{
+				auto _sy = sy;
+				auto _sz = sz;
+				if (__abs(sy) < fixed(0.00001)) _sy = sx;
+				if (__abs(sz) < fixed(0.00001)) _sz = _sy;
+				Affine out;
+				out.m_data[0] = sx;
+				out.m_data[5] = _sy;
+				out.m_data[10] = _sz;
+				out.m_kind = General;
+				return out;
+			}
+			static Affine rotateX(const fixed& theta) { return rotate(1, 2, theta); }
+			static Affine rotateY(const fixed& theta) { return rotate(2, 0, theta); }
+			static Affine rotateZ(const fixed& theta) { return rotate(0, 1, theta); }
+
+			fixed at(size_t x, size_t y) const { return m_data[x + y * my_width]; }
+			const fixed* data() const { return m_data; }
+			Kind kind() const { return m_kind; }
+			bool is_identity() const { return m_kind == Identity; }
+
+			Matrix matrix() const
+			{
+				Matrix out;
+				for (size_t i = 0; i < sizeof(m_data) / sizeof(m_data[0]); ++i)
+					out.set_at(i % my_width, i / my_width, m_data[i]);
+				return out;
+			}
+
+			// out = lhs * rhs; out may be the same object as lhs or rhs
+			static void multiply(const Affine& lhs, const Affine& rhs, Affine& out);
+
+			// out[i] = *this * in[i] for the whole array in one call; in and
+			// out may point to the same array
+			void transform(const Vertex* in, Vertex* out, size_t count) const;
+			void transform(const Vector* in, Vector* out, size_t count) const;
+
+		private:
+			fixed m_data[my_width * my_height];
+			Kind m_kind;
+
+			static Affine rotate(size_t a, size_t b, const fixed& theta)
+			{
+				fixed cosTheta = cos(theta);
+				fixed sinTheta = sin(theta);
+				Affine out;
+				out.m_data[a + a * my_width] = cosTheta;
+				out.m_data[b + a * my_width] = -sinTheta;
+				out.m_data[a + b * my_width] = sinTheta;
+				out.m_data[b + b * my_width] = cosTheta;
+				out.m_kind = General;
+				return out;
+			}
+		};
+
 		inline Vector operator - (const Vertex& lhs, const Vertex& rhs)
 		{
 			return { lhs.x() - rhs.x(), lhs.y() - rhs.y(), lhs.z() - rhs.z() };
@@ -638,17 +623,44 @@ namespace studio
 
 		inline Vector operator* (const Matrix& lhs, const Vector& rhs)
 		{
-			return lhs.multiply(rhs);
+			Vector out;
+			lhs.transform(&rhs, &out, 1);
+			return out;
 		}
 
 		inline Vertex operator* (const Matrix& lhs, const Vertex& rhs)
 		{
-			return lhs.multiply(rhs);
+			Vertex out;
+			lhs.transform(&rhs, &out, 1);
+			return out;
 		}
 
 		inline Matrix operator* (const Matrix& lhs, const Matrix& rhs)
 		{
-			return lhs.multiply(rhs);
+			Matrix out;
+			Matrix::multiply(lhs, rhs, out);
+			return out;
+		}
+
+		inline Vector operator* (const Affine& lhs, const Vector& rhs)
+		{
+			Vector out;
+			lhs.transform(&rhs, &out, 1);
+			return out;
+		}
+
+		inline Vertex operator* (const Affine& lhs, const Vertex& rhs)
+		{
+			Vertex out;
+			lhs.transform(&rhs, &out, 1);
+			return out;
+		}
+
+		inline Affine operator* (const Affine& lhs, const Affine& rhs)
+		{
+			Affine out;
+			Affine::multiply(lhs, rhs, out);
+			return out;
 		}
 
 	}
@@ -27,6 +27,7 @@
 
 #include "fundamentals.hpp"
 #include "shared_vector.hpp"
+#include "simd.hpp"
 
 namespace studio
 {
@@ -35,6 +36,9 @@ namespace studio
 		virtual ~Light() {}
 		virtual const math::Vertex& position() const = 0;
 		virtual fixed power() const = 0;
+		// distance, at which the light fades out completely; 0 for
+		// a light reaching everywhere
+		virtual fixed radius() const { return 0; }
 	};
 
 	typedef std::shared_ptr<Light> LightPtr;
@@ -44,49 +48,160 @@ namespace studio
 	{
 		math::Vertex m_position;
 		fixed m_power;
+		fixed m_radius;
 	public:
-		SimpleLight(const math::Vertex& position, const fixed& power)
+		SimpleLight(const math::Vertex& position, const fixed& power, const fixed& radius = fixed())
 			: m_position(position)
 			, m_power(power)
+			, m_radius(radius)
 		{}
 
 		const math::Vertex& position() const override { return m_position; }
 		fixed power() const override { return m_power;  }
+		fixed radius() const override { return m_radius; }
+
+		void moveTo(const math::Vertex& position) { m_position = position; }
 	};
 
-	struct LightInfo
+	// The lights of a single frame, as seen by a single camera: the
+	// positions are already in the camera space and the power is already
+	// divided, stored as flat arrays shared by all the triangles of the
+	// frame.
+	//
+	// Tiled light culling: lights with a radius only reach a part of the
+	// screen, so the screen is cut into TILE x TILE tiles, each with its
+	// own list of the lights reaching it. A list is a Range of the
+	// arrays, starting on a pack boundary and padded with lights of no
+	// power.
+	class LightCache
 	{
-		math::Vertex position;
-		fixed power;
-		explicit LightInfo(const math::Vertex& position, const fixed& power)
-			: position(position)
-			, power(power / 100)
+	public:
+		enum { TILE = 32 };
+
+		struct Source
 		{
-		}
+			math::Vertex position; // camera space
+			fixed power;
+			fixed radius; // 0 for no limit
+			bool bounded; // false, if the light may reach any pixel
+			fixed minX, minY, maxX, maxY; // screen rectangle reached, if bounded
+		};
+
+		struct Range
+		{
+			size_t offset;
+			size_t count;
+		};
+
+	private:
+		simd::aligned_buffer<fixed> m_x;
+		simd::aligned_buffer<fixed> m_y;
+		simd::aligned_buffer<fixed> m_z;
+		simd::aligned_buffer<fixed> m_power;
+		simd::aligned_buffer<fixed> m_invRadiusSq; // in thousands, 0 for no limit
+		size_t m_size;
+		Range m_all;
+
+		int m_width;
+		int m_height;
+		int m_tilesX;
+		int m_tilesY;
+		std::vector<Range> m_tiles; // empty, if every tile would get all the lights
+
+	public:
+		// width and height of the screen the tiles are cut from; with
+		// no screen, there are no tiles either
+		LightCache(const std::vector<Source>& lights, int width, int height);
+
+		size_t size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+
+		const Range& all() const { return m_all; }
+		// lights reaching the screen point (centered, as in Canvas)
+		const Range& tile(const math::Point& pt) const;
+
+		const fixed* x() const { return m_x.data(); }
+		const fixed* y() const { return m_y.data(); }
+		const fixed* z() const { return m_z.data(); }
+		const fixed* power() const { return m_power.data(); }
+		const fixed* invRadiusSq() const { return m_invRadiusSq.data(); }
 	};
+
+	typedef std::shared_ptr<const LightCache> LightCachePtr;
+
 	struct LightsInfo
 	{
-		std::vector<LightInfo> m_lights;
-		math::Vector m_normal;
+		LightCachePtr m_lights;
+		math::Vector m_normal; // unit length
+
+		LightsInfo() {}
+		LightsInfo(const LightCachePtr& lights, const math::Vector& normal)
+			: m_lights(lights)
+			, m_normal(normal)
+		{
+			auto length = normal.length();
+			if (length != 0)
+				m_normal = normal / length;
+		}
 
 		fixed getIntensity(const math::Vertex& point) const
 		{
-			fixed intensity = 1;
-			if (!m_lights.empty())
+			if (!m_lights || m_lights->empty())
+				return 1;
+			return getIntensity(point, m_lights->all());
+		}
+
+		// the point, as seen at the screen point, only needs the lights
+		// of its tile
+		fixed getIntensity(const math::Vertex& point, const math::Point& screen) const
+		{
+			if (!m_lights || m_lights->empty())
+				return 1;
+			return getIntensity(point, m_lights->tile(screen));
+		}
+
+		// Every light adds 1 - cos(normal, v) * power / |v|^2, with v
+		// measured in thousands. The lights go through in packs; with the
+		// unit normal, cos * power / |v|^2 is (normal . v) * power / |v|^3,
+		// which needs no division but the reciprocal square root.
+		// Lights with a radius are faded by 1 - |v|^2 / radius^2 down to
+		// nothing at the radius, so the lights culled from a tile would
+		// not have added anything anyway. Padding lanes have no power and
+		// add nothing either.
+		fixed getIntensity(const math::Vertex& point, const LightCache::Range& range) const
+		{
+			using simd::pack;
+			auto scale = pack::splat(fixed(1) / 1000);
+			auto tiny = pack::splat(fixed(1) / (1 << 16)); // keeps 0 * inf out of the padding
+			auto zero = pack::splat(fixed());
+			auto one = pack::splat(fixed(1));
+			auto px = pack::splat(point.x());
+			auto py = pack::splat(point.y());
+			auto pz = pack::splat(point.z());
+			auto nx = pack::splat(m_normal.i());
+			auto ny = pack::splat(m_normal.j());
+			auto nz = pack::splat(m_normal.k());
+
+			auto lx = m_lights->x() + range.offset;
+			auto ly = m_lights->y() + range.offset;
+			auto lz = m_lights->z() + range.offset;
+			auto power = m_lights->power() + range.offset;
+			auto invRadiusSq = m_lights->invRadiusSq() + range.offset;
+			auto falloff = zero;
+			for (size_t i = 0, count = simd::padded(range.count); i < count; i += pack::width)
 			{
-				intensity = 0;
-				for (auto && light : m_lights)
-				{
-					auto v = point - light.position;
-					fixed lengthSq = v.lengthSquared() / 1000000;
-					//if (lengthSq > 1)
-					//	lengthSq = 1;
-					intensity += 1 - math::Vector::cosTheta(m_normal, v) * light.power / lengthSq;
-				}
-				intensity /= 2;
-				intensity /= m_lights.size();
+				auto vx = (px - pack::load(lx + i)) * scale;
+				auto vy = (py - pack::load(ly + i)) * scale;
+				auto vz = (pz - pack::load(lz + i)) * scale;
+				auto lengthSq = vx * vx + vy * vy + vz * vz;
+				auto inv = rsqrt(max(lengthSq, tiny));
+				auto fade = max(one - lengthSq * pack::load(invRadiusSq + i), zero);
+				falloff = falloff + (nx * vx + ny * vy + nz * vz) * pack::load(power + i) * fade * inv * inv * inv;
 			}
-			return intensity;
+
+			// the lights culled away still count, with nothing to add
+			fixed count((int) m_lights->size());
+			return (count - falloff.sum()) / 2 / count;
 		}
 	};
 }
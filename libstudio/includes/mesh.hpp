@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __LIBSTUDIO_MESH_HPP__
+#define __LIBSTUDIO_MESH_HPP__
+
+#include "renderable.hpp"
+#include <vector>
+
+namespace studio
+{
+	// Indexed triangle list. The vertices are stored once and shared by
+	// all the faces using them; every face is three indices into the
+	// vertex buffer plus an index into the material table.
+	class Mesh : public Renderable
+	{
+	public:
+		typedef std::vector<math::Vertex> vertices_t;
+		typedef std::vector<u32> indices_t;
+		typedef std::vector<MaterialPtr> materials_t;
+
+		Mesh();
+
+		u32 addVertex(const math::Vertex& pt);
+		size_t addFace(u32 a, u32 b, u32 c);
+		// sets the material of count faces starting at first
+		void setMaterial(size_t first, size_t count, const MaterialPtr& material);
+
+		void renderTo(const ICamera* cam, const math::Affine& parent, const Lights& lights) const override;
+		MaterialPtr material() const override { return nullptr; }
+		Bounds bounds() const override { return m_bounds; }
+
+		const vertices_t& vertices() const { return m_vertices; }
+		const indices_t& indices() const { return m_indices; }
+		size_t faceCount() const { return m_faceMaterials.size(); }
+		const u32* face(size_t i) const { return &m_indices[i * 3]; }
+		const MaterialPtr& faceMaterial(size_t i) const { return m_materials[m_faceMaterials[i]]; }
+		math::Vector faceNormal(size_t i) const
+		{
+			auto f = face(i);
+			return math::Vector::crossProduct(m_vertices[f[2]] - m_vertices[f[1]], m_vertices[f[0]] - m_vertices[f[1]]);
+		}
+
+	private:
+		vertices_t m_vertices;
+		indices_t m_indices;
+		indices_t m_faceMaterials;
+		materials_t m_materials; // m_materials[0] is the "no material" slot
+		Bounds m_bounds; // grown by addVertex()
+	};
+}
+
+#endif //__LIBSTUDIO_MESH_HPP__
\ No newline at end of file
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __LIBSTUDIO_RASTERIZER_HPP__
+#define __LIBSTUDIO_RASTERIZER_HPP__
+
+#include "canvas.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace studio
+{
+	namespace raster
+	{
+		enum
+		{
+			TILE = 8,          // tiles are TILE x TILE pixels
+			SUBPIXEL_BITS = 4, // vertices are snapped to 1/16th of a pixel
+			SUBPIXEL = 1 << SUBPIXEL_BITS,
+			BIN = 64           // bins are BIN x BIN pixels, made of whole tiles
+		};
+
+		// E(x, y) = a*x + b*y + c, with x and y in subpixels; a pixel
+		// belongs to the triangle, if E >= 0 for all three edges. The
+		// fill rule is already folded into c.
+		struct Edge
+		{
+			long long a, b, c;
+
+			long long at(int x, int y) const { return a * (x << SUBPIXEL_BITS) + b * (y << SUBPIXEL_BITS) + c; }
+			long long stepX() const { return a << SUBPIXEL_BITS; }
+			long long stepY() const { return b << SUBPIXEL_BITS; }
+		};
+
+		// Edge functions, depth plane and the pixel bounding box of one
+		// screen-space triangle. Pixels are sampled at integer
+		// coordinates, same as the scanline filler.
+		struct Setup
+		{
+			Edge m_edges[3];
+			double m_z0, m_dzdx, m_dzdy; // z(x, y) = m_z0 + x * m_dzdx + y * m_dzdy
+			fixed m_nearest; // smallest z of the three vertices
+			int m_minX, m_minY, m_maxX, m_maxY; // inclusive, inside the target
+
+			// pts are in the bitmap coordinates (after CanvasImpl::tr);
+			// false, if there is no pixel to cover
+			bool init(const PointWithDepth (&pts)[3], int width, int height);
+
+			fixed depth(int x, int y) const { return fixed(m_z0 + x * m_dzdx + y * m_dzdy); }
+		};
+
+		// Visits all the covered pixels of a single tile, calling
+		// visit(x, y, count, z, dzdx) for every row. A triangle is convex,
+		// so the covered pixels of a row are always a single run. Inside
+		// the tile the edge functions and the depth are stepped with
+		// additions only.
+		template <typename Visitor>
+		void tile(const Setup& setup, int tileX, int tileY, Visitor&& visit)
+		{
+			int x0 = std::max(tileX, setup.m_minX);
+			int y0 = std::max(tileY, setup.m_minY);
+			int x1 = std::min(tileX + TILE - 1, setup.m_maxX);
+			int y1 = std::min(tileY + TILE - 1, setup.m_maxY);
+			if (x0 > x1 || y0 > y1)
+				return;
+
+			// trivial reject: the corner most inside an edge is outside;
+			// trivial accept: the corner most outside is inside all edges
+			bool inside = true;
+			for (auto && e : setup.m_edges)
+			{
+				auto best = e.at(e.a > 0 ? x1 : x0, e.b > 0 ? y1 : y0);
+				if (best < 0)
+					return;
+				auto worst = e.at(e.a > 0 ? x0 : x1, e.b > 0 ? y0 : y1);
+				if (worst < 0)
+					inside = false;
+			}
+
+			fixed dzdx(setup.m_dzdx);
+			fixed dzdy(setup.m_dzdy);
+			fixed zRow = setup.depth(x0, y0);
+
+			if (inside)
+			{
+				for (int y = y0; y <= y1; ++y, zRow += dzdy)
+					visit(x0, y, x1 - x0 + 1, zRow, dzdx);
+				return;
+			}
+
+			const Edge& A = setup.m_edges[0];
+			const Edge& B = setup.m_edges[1];
+			const Edge& C = setup.m_edges[2];
+			long long rowA = A.at(x0, y0), rowB = B.at(x0, y0), rowC = C.at(x0, y0);
+			for (int y = y0; y <= y1; ++y, zRow += dzdy, rowA += A.stepY(), rowB += B.stepY(), rowC += C.stepY())
+			{
+				long long a = rowA, b = rowB, c = rowC;
+				fixed z = zRow;
+				int x = x0;
+				for (; x <= x1 && (a | b | c) < 0; ++x, z += dzdx, a += A.stepX(), b += B.stepX(), c += C.stepX())
+					;
+				int start = x;
+				fixed zStart = z;
+				for (; x <= x1 && (a | b | c) >= 0; ++x, a += A.stepX(), b += B.stepX(), c += C.stepX())
+					;
+				if (x > start)
+					visit(start, y, x - start, zStart, dzdx);
+			}
+		}
+
+		// Edge of the scanline filler, with x and z interpolated along y.
+		struct Slope
+		{
+			fixed y0, dy;
+			fixed x0, dx;
+			fixed z0, dz;
+
+			Slope(const fixed& y0, const fixed& y1, const fixed& x0, const fixed& x1, const fixed& z0, const fixed& z1)
+				: y0(y0), dy(y1 - y0)
+				, x0(x0), dx(x1 - x0)
+				, z0(z0), dz(z1 - z0)
+			{
+			}
+
+			void calc(const fixed& y, fixed& x, fixed& z) const
+			{
+				auto dY = y - y0;
+				x = x0 + dY / dy * dx;
+				z = z0 + dY / dy * dz;
+			}
+		};
+
+		// Visits every tile touched by the bounding box.
+		template <typename Visitor>
+		void fill(const Setup& setup, Visitor&& visit)
+		{
+			int startX = setup.m_minX & ~(TILE - 1);
+			int startY = setup.m_minY & ~(TILE - 1);
+			for (int y = startY; y <= setup.m_maxY; y += TILE)
+				for (int x = startX; x <= setup.m_maxX; x += TILE)
+					tile(setup, x, y, visit);
+		}
+
+		// Sort-middle stage: the triangles are set up as they come and
+		// sorted into screen bins; flush() rasterizes the bins in
+		// parallel. Every bin keeps the submission order and is owned by
+		// a single thread, so the pixels need no locking and the result
+		// does not depend on the thread count.
+		class Bins
+		{
+			struct Entry
+			{
+				Setup m_setup;
+				ShaderPtr m_shader;
+				u32 m_id;
+			};
+
+			int m_binsX;
+			int m_binsY;
+			std::vector<Entry> m_triangles;
+			std::vector<std::vector<u32>> m_bins;
+		public:
+			Bins(int width, int height)
+				: m_binsX((width + BIN - 1) / BIN)
+				, m_binsY((height + BIN - 1) / BIN)
+				, m_bins(m_binsX * m_binsY)
+			{
+			}
+
+			bool empty() const { return m_triangles.empty(); }
+			size_t size() const { return m_triangles.size(); }
+
+			// id is not used here, it is handed back to the visitor
+			void add(const Setup& setup, const ShaderPtr& shader, u32 id = 0)
+			{
+				u32 index = (u32) m_triangles.size();
+				m_triangles.push_back({ setup, shader, id });
+
+				for (int y = setup.m_minY / BIN; y <= setup.m_maxY / BIN; ++y)
+					for (int x = setup.m_minX / BIN; x <= setup.m_maxX / BIN; ++x)
+						m_bins[x + y * m_binsX].push_back(index);
+			}
+
+			// Calls visit(setup, shader, id, x0, y0, x1, y1) for every
+			// triangle of every bin, with the part of the bounding box
+			// inside that bin (inclusive, x0 and y0 aligned to TILE). The
+			// visitor is called from many threads, but never for the same
+			// bin from two of them.
+			template <typename Visitor>
+			void flush(Visitor&& visit)
+			{
+				if (m_triangles.empty())
+					return;
+
+				std::vector<size_t> busy;
+				for (size_t i = 0; i < m_bins.size(); ++i)
+					if (!m_bins[i].empty())
+						busy.push_back(i);
+
+				ThreadPool::instance().parallel_for(busy.size(), [&](size_t i)
+				{
+					auto && bin = m_bins[busy[i]];
+					int binX = (int) (busy[i] % m_binsX) * BIN;
+					int binY = (int) (busy[i] / m_binsX) * BIN;
+
+					for (auto index : bin)
+					{
+						auto && entry = m_triangles[index];
+						auto && setup = entry.m_setup;
+
+						int x0 = std::max(binX, setup.m_minX & ~(TILE - 1));
+						int y0 = std::max(binY, setup.m_minY & ~(TILE - 1));
+						int x1 = std::min(binX + BIN - 1, setup.m_maxX);
+						int y1 = std::min(binY + BIN - 1, setup.m_maxY);
+						visit(setup, entry.m_shader.get(), entry.m_id, x0, y0, x1, y1);
+					}
+					bin.clear();
+				});
+
+				m_triangles.clear();
+			}
+		};
+
+		// Deferred shading: the rasterizer only keeps the ID of the
+		// front-most triangle of every pixel and resolve() runs the
+		// shaders once per visible pixel, after all the depth tests.
+		class IdBuffer
+		{
+			int m_width;
+			int m_height;
+			std::vector<u32> m_ids; // 0 for pixels with nothing deferred
+			std::vector<ShaderPtr> m_shaders; // shader of ID n is m_shaders[n - 1]
+		public:
+			IdBuffer(int width, int height)
+				: m_width(width)
+				, m_height(height)
+				, m_ids(width * height, 0)
+			{
+			}
+
+			bool empty() const { return m_shaders.empty(); }
+
+			u32 add(const ShaderPtr& shader)
+			{
+				m_shaders.push_back(shader);
+				return (u32) m_shaders.size();
+			}
+
+			void set(int x, int y, u32 id) { m_ids[y * m_width + x] = id; }
+
+			// Calls plot(shader, x, y, count) for every run of pixels with
+			// the same ID, rows spread over the thread pool.
+			template <typename Plot>
+			void resolve(Plot&& plot)
+			{
+				if (m_shaders.empty())
+					return;
+
+				ThreadPool::instance().parallel_for(m_height, [&](size_t y)
+				{
+					auto line = &m_ids[y * m_width];
+					int x = 0;
+					while (x < m_width)
+					{
+						auto id = line[x];
+						int start = x;
+						while (x < m_width && line[x] == id)
+							line[x++] = 0;
+						if (id)
+							plot(m_shaders[id - 1].get(), start, (int) y, x - start);
+					}
+				});
+
+				m_shaders.clear();
+			}
+		};
+	}
+}
+
+#endif //__LIBSTUDIO_RASTERIZER_HPP__
\ No newline at end of file
@@ -28,56 +28,124 @@
 #include "fundamentals.hpp"
 #include "light.hpp"
 #include "material.hpp"
+#include <algorithm>
 
 namespace studio
 {
 	struct ICamera;
+	class Container;
+
+	// Axis-aligned box, empty until the first point is added
+	struct Bounds
+	{
+		math::Vertex lo;
+		math::Vertex hi;
+		bool empty;
+
+		Bounds() : empty(true) {}
+
+		void add(const math::Vertex& pt)
+		{
+			if (empty)
+			{
+				lo = hi = pt;
+				empty = false;
+				return;
+			}
+			lo = { std::min(lo.x(), pt.x()), std::min(lo.y(), pt.y()), std::min(lo.z(), pt.z()) };
+			hi = { std::max(hi.x(), pt.x()), std::max(hi.y(), pt.y()), std::max(hi.z(), pt.z()) };
+		}
+
+		// adds the box around the other box, as seen through the matrix
+		void add(const Bounds& other, const math::Affine& matrix)
+		{
+			if (other.empty)
+				return;
+			math::Vertex pts[8];
+			other.corners(pts);
+			matrix.transform(pts, pts, 8);
+			for (auto && pt : pts)
+				add(pt);
+		}
+
+		void corners(math::Vertex (&pts)[8]) const
+		{
+			for (int i = 0; i < 8; ++i)
+				pts[i] = { i & 1 ? hi.x() : lo.x(), i & 2 ? hi.y() : lo.y(), i & 4 ? hi.z() : lo.z() };
+		}
+	};
 
 	class Renderable
 	{
-		math::Matrix m_local;
-	public:
+		friend class Container;
 
+		math::Affine m_local;
+		unsigned m_revision;
+		Renderable* m_parent; // set by the Container::adopt()
+	protected:
+		// to be called by anything changing the geometry; the change is
+		// counted by every container on the way up as well
+		void touch()
+		{
+			for (auto node = this; node; node = node->m_parent)
+				++node->m_revision;
+		}
+	public:
+		Renderable() : m_revision(0), m_parent(nullptr) {}
 		virtual ~Renderable() {}
 
-		virtual void renderTo(const ICamera* cam, const math::Matrix& parent, const Lights& lights) const = 0;
+		// Grows with every change to the geometry of this object and,
+		// for the containers, of everything inside; what was rendered
+		// from the object is still valid while it stays the same.
+		unsigned revision() const { return m_revision; }
+
+		virtual void renderTo(const ICamera* cam, const math::Affine& parent, const Lights& lights) const = 0;
 		virtual MaterialPtr material() const = 0;
+		// the box around the geometry, in the object's own space (before
+		// the localMatrix())
+		virtual Bounds bounds() const = 0;
 		virtual math::Vector normal() const
 		{
 			static math::Vector def(1, 0, 0); // i-hat
 			return def;
 		}
 
-		const math::Matrix& localMatrix() const { return m_local; }
+		const math::Affine& localMatrix() const { return m_local; }
 
 		void resetMatrix()
 		{
-			m_local = math::Matrix::identity();
+			m_local = math::Affine::identity();
+			touch();
 		}
 
 		void translate(const fixed& dx, const fixed& dy = fixed(), const fixed& dz = fixed())
 		{
-			m_local = m_local * math::Matrix::translate(dx, dy, dz);
+			m_local = m_local * math::Affine::translate(dx, dy, dz);
+			touch();
 		}
 
 		void scale(const fixed& sx, const fixed& sy = fixed(), const fixed& sz = fixed())
 		{
-			m_local = m_local * math::Matrix::scale(sx, sy, sz);
+			m_local = m_local * math::Affine::scale(sx, sy, sz);
+			touch();
 		}
 
 		void rotateX(const fixed& theta)
 		{
-			m_local = m_local * math::Matrix::rotateX(theta);
+			m_local = m_local * math::Affine::rotateX(theta);
+			touch();
 		}
 
 		void rotateY(const fixed& theta)
 		{
-			m_local = m_local * math::Matrix::rotateY(theta);
+			m_local = m_local * math::Affine::rotateY(theta);
+			touch();
 		}
 
 		void rotateZ(const fixed& theta)
 		{
-			m_local = m_local * math::Matrix::rotateZ(theta);
+			m_local = m_local * math::Affine::rotateZ(theta);
+			touch();
 		}
 	};
 }
@@ -59,9 +59,25 @@ namespace studio
 		template <typename T>
 		struct choose { typedef T type; };
 
-		struct camera { static inline Cameras& get(Scene& ref) { return ref.m_cameras; } };
-		struct light { static inline Lights& get(Scene& ref) { return ref.m_lights; } };
-		struct rest { static inline Renderables& get(Scene& ref) { return ref.m_children; } };
+		struct camera
+		{
+			static inline Cameras& get(Scene& ref) { return ref.m_cameras; }
+			static inline void adopt(Scene&, ICamera*) {}
+		};
+		struct light
+		{
+			static inline Lights& get(Scene& ref) { return ref.m_lights; }
+			static inline void adopt(Scene&, Light*) {}
+		};
+		struct rest
+		{
+			static inline Renderables& get(Scene& ref) { return ref.m_children; }
+			static inline void adopt(Scene& ref, Renderable* child)
+			{
+				ref.adopt(child);
+				ref.touch();
+			}
+		};
 
 	public:
 		template <typename T, typename... Args>
@@ -75,7 +91,9 @@ namespace studio
 						choose<rest>
 					>
 				>::type children;
-			return children::get(*this).emplace_back<T>(std::forward<Args>(args)...);
+			auto child = children::get(*this).emplace_back<T>(std::forward<Args>(args)...);
+			children::adopt(*this, child.get());
+			return child;
 		}
 
 		void renderAllCameras() const
@@ -86,7 +104,9 @@ namespace studio
 
 		void renderTo(const ICamera* cam) const
 		{
-			Container::renderTo(cam, math::Matrix::identity(), m_lights);
+			cam->beginFrame();
+			Container::renderTo(cam, math::Affine::identity(), m_lights);
+			cam->flush();
 		}
 
 		const Lights& lights() const { return m_lights; }
@@ -33,98 +33,121 @@ namespace studio
 {
 	struct Shader
 	{
+		// the final classes below, for dispatch()
+		enum Kind { Other, Uniform, Lights, Gouraud };
+
+		Shader(Kind kind = Other) : m_kind(kind) {}
 		virtual ~Shader() {}
+		Kind kind() const { return m_kind; }
 		virtual Color shade(const math::Point& pt) = 0;
+
+		// Shades count pixels of a single row, starting at start and
+		// moving step along the x axis between them.
+		virtual void shadeSpan(const math::Point& start, const fixed& step, size_t count, Color* out)
+		{
+			auto pt = start;
+			for (size_t i = 0; i < count; ++i, pt = { pt.x() + step, pt.y() })
+				out[i] = shade(pt);
+		}
+	private:
+		Kind m_kind;
 	};
 
-	class UniformShader : public Shader
+	typedef std::shared_ptr<Shader> ShaderPtr;
+
+	class UniformShader final : public Shader
 	{
 		Color m_color;
 	public:
 		UniformShader(const Color& color)
-			: m_color(color)
+			: Shader(Uniform)
+			, m_color(color)
 		{}
 
 		Color shade(const math::Point& pt) override
 		{
 			return m_color;
 		}
+
+		void shadeSpan(const math::Point&, const fixed&, size_t count, Color* out) override
+		{
+			std::fill(out, out + count, m_color);
+		}
+	};
+
+	// f(x, y) = f0 + x * dx + y * dy over the screen, through the values
+	// f0, f1 and f2 at the three points
+	struct ScreenPlane
+	{
+		fixed f0;
+		fixed dx;
+		fixed dy;
+
+		ScreenPlane() {}
+		ScreenPlane(const math::Point (&pts)[3], const fixed& f0, const fixed& f1, const fixed& f2);
+
+		fixed at(const math::Point& pt) const { return f0 + pt.x() * dx + pt.y() * dy; }
 	};
 
-	class LightsShader : public Shader
+	// the material color (white without one) under the light intensity
+	Color lightColor(const MaterialPtr& material, const fixed& intensity);
+
+	class LightsShader final : public Shader
 	{
 		MaterialPtr m_material;
 		LightsInfo m_info;
 
-		struct ProjectedPoint
-		{
-			fixed y;
-			fixed x;
-
-			fixed x3;
-			fixed y3;
-			fixed z3;
-
-			ProjectedPoint() {}
-			ProjectedPoint(const math::Point& p, const math::Vertex& v)
-				: x(p.x())
-				, y(p.y())
-				, x3(v.x())
-				, y3(v.y())
-				, z3(v.z())
-			{
-			}
-			ProjectedPoint(const fixed& x, const fixed& y, const fixed& x3, const fixed& y3, const fixed& z3)
-				: x(x)
-				, y(y)
-				, x3(x3)
-				, y3(y3)
-				, z3(z3)
-			{}
-		};
-
-		struct Delta
-		{
-			fixed dy;
-			fixed dx;
-
-			fixed dx3;
-			fixed dy3;
-			fixed dz3;
-
-			Delta() {}
-			Delta(const ProjectedPoint& p0, const ProjectedPoint& p1)
-				: dx(p1.x - p0.x)
-				, dy(p1.y - p0.y)
-				, dx3(p1.x3 - p0.x3)
-				, dy3(p1.y3 - p0.y3)
-				, dz3(p1.z3 - p0.z3)
-			{
-			}
-
-			ProjectedPoint interpolate(const fixed& y, const ProjectedPoint& pt)
-			{
-				if (!dy) return pt;
-				auto step = (y - pt.y) / dy;
-				return { pt.x + step * dx, y, pt.x3 + step * dx3, pt.y3 + step * dy3, pt.z3 + step * dz3 };
-			}
-
-			ProjectedPoint interpolate(const ProjectedPoint& pt, const fixed& x)
-			{
-				if (!dx) return pt;
-				auto step = (x - pt.x) / dx;
-				return { x, pt.y + step * dy, pt.x3 + step * dx3, pt.y3 + step * dy3, pt.z3 + step * dz3 };
-			}
-		};
-
-		ProjectedPoint m_func[3];
-		Delta A, B, C;
+		// 1/w and the view-space position divided by w are linear in
+		// the screen space. Their gradients are taken once per triangle,
+		// the pixels only step them and divide by 1/w to get the
+		// perspective-correct position back.
+		ScreenPlane m_invW;
+		ScreenPlane m_x3, m_y3, m_z3;
 
 		math::Vertex counterProject(const math::Point& pt);
 	public:
-		LightsShader(const MaterialPtr& material, LightsInfo && info, const math::Point& p0, const math::Point& p1, const math::Point& p2, const math::Vertex& v0, const math::Vertex& v1, const math::Vertex& v2);
+		LightsShader(const MaterialPtr& material, LightsInfo && info, const math::Point& p0, const math::Point& p1, const math::Point& p2, const math::Vertex& v0, const math::Vertex& v1, const math::Vertex& v2, const fixed& eye);
 		Color shade(const math::Point& pt) override;
+		void shadeSpan(const math::Point& start, const fixed& step, size_t count, Color* out) override;
 	};
+
+	// Gouraud shading: the lighting is only taken at the vertices and
+	// the intensity is interpolated linearly over the screen.
+	class GouraudShader final : public Shader
+	{
+		MaterialPtr m_material;
+		ScreenPlane m_intensity;
+	public:
+		GouraudShader(const MaterialPtr& material, const math::Point& p0, const math::Point& p1, const math::Point& p2, const fixed& i0, const fixed& i1, const fixed& i2);
+		Color shade(const math::Point& pt) override;
+		void shadeSpan(const math::Point& start, const fixed& step, size_t count, Color* out) override;
+	};
+
+	// Calls visit(shader) with the shader cast down to its final class,
+	// if it is one of the shaders above, so that the rasterizer can be
+	// instantiated for it and call it without the virtual dispatch. Any
+	// other shader is visited as a plain Shader*. The class is recorded
+	// once, when the shader is made for its triangle, so every span and
+	// run only pays for a switch.
+	template <typename Visitor>
+	inline void dispatch(Shader* shader, Visitor&& visit)
+	{
+		switch (shader->kind())
+		{
+		case Shader::Lights:
+			visit(static_cast<LightsShader*>(shader));
+			break;
+		case Shader::Gouraud:
+			visit(static_cast<GouraudShader*>(shader));
+			break;
+		case Shader::Uniform:
+			visit(static_cast<UniformShader*>(shader));
+			break;
+		default:
+			visit(shader);
+			break;
+		}
+	}
 }
 
 #endif //__LIBSTUDIO_SHADER_HPP__
\ No newline at end of file
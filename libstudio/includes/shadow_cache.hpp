@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __LIBSTUDIO_SHADOW_CACHE_HPP__
+#define __LIBSTUDIO_SHADOW_CACHE_HPP__
+
+#include "shadow_map.hpp"
+#include "scene.hpp"
+#include <map>
+#include <mutex>
+
+namespace studio
+{
+	// Shadows of the lights of a scene, kept from one frame to the next.
+	// The ShadowMap of a light is rendered again only when the light
+	// moved or the geometry of the scene changed (Scene::revision());
+	// the mask, made from the map, also depends on the camera and the
+	// size of the canvas it was made for. Anything else, like the power
+	// of a light or the materials, leaves both of them alone.
+	//
+	// Different lights may be asked for from different threads at once;
+	// every light has a lock of its own, held while its shadows are
+	// checked and made again.
+	class ShadowCache
+	{
+		struct Entry
+		{
+			std::mutex mutex;
+
+			math::Vertex light;
+			unsigned geometry;
+			std::shared_ptr<ShadowMap> map;
+
+			int width;
+			int height;
+			math::Vertex position;
+			math::Vertex target;
+			fixed eye;
+			ShadowMaskPtr mask;
+
+			Entry() : geometry(0), width(0), height(0) {}
+		};
+		typedef std::shared_ptr<Entry> EntryPtr;
+
+		std::map<const Light*, EntryPtr> m_entries;
+		std::mutex m_mutex;
+		int m_size;
+
+		static bool same(const math::Vertex& lhs, const math::Vertex& rhs)
+		{
+			return lhs.x() == rhs.x() && lhs.y() == rhs.y() && lhs.z() == rhs.z();
+		}
+
+		// shared, so that invalidate() or clear() may drop an entry
+		// still in use by another thread
+		EntryPtr entry(const Light* light)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto && cached = m_entries[light];
+			if (!cached)
+				cached = std::make_shared<Entry>();
+			return cached;
+		}
+
+	public:
+		// size is the size of a face of the shadow maps
+		explicit ShadowCache(int size = 1024) : m_size(size) {}
+
+		template <typename Canvas>
+		ShadowMaskPtr mask(const Scene& scene, const Light& light, const Camera& camera, const Canvas& canvas)
+		{
+			auto cached = entry(&light);
+			std::lock_guard<std::mutex> lock(cached->mutex);
+			auto geometry = scene.revision();
+
+			if (!cached->map || cached->geometry != geometry || !same(cached->light, light.position()))
+			{
+				cached->map = std::make_shared<ShadowMap>(light.position(), m_size);
+				scene.renderTo(cached->map.get());
+				cached->light = light.position();
+				cached->geometry = geometry;
+				cached->mask = nullptr;
+			}
+
+			if (!cached->mask || cached->width != canvas.width() || cached->height != canvas.height() ||
+				cached->eye != camera.eye() || !same(cached->position, camera.position()) || !same(cached->target, camera.target()))
+			{
+				cached->mask = cached->map->mask(camera, canvas);
+				cached->width = canvas.width();
+				cached->height = canvas.height();
+				cached->position = camera.position();
+				cached->target = camera.target();
+				cached->eye = camera.eye();
+			}
+
+			return cached->mask;
+		}
+
+		// forgets the shadows of a single light, e.g. a removed one
+		void invalidate(const Light* light)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_entries.erase(light);
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_entries.clear();
+		}
+	};
+}
+
+#endif //__LIBSTUDIO_SHADOW_CACHE_HPP__
\ No newline at end of file
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __LIBSTUDIO_SHADOW_MAP_HPP__
+#define __LIBSTUDIO_SHADOW_MAP_HPP__
+
+#include "camera.hpp"
+#include "bitmap.hpp"
+#include <vector>
+
+namespace studio
+{
+	// Depth of the scene as seen from a point light: six square depth
+	// maps, one for every face of a cube around the light. The map is
+	// rendered like any other camera (Scene::renderTo), after which
+	// telling, if a point is lit, takes a single lookup.
+	//
+	// Every texel keeps zNear / depth of the closest surface, where the
+	// depth is measured along the axis of the face. The reciprocal is
+	// linear in the face's screen space, so the rasterizer interpolates
+	// it exactly; 0 is a texel with nothing in it.
+	class ShadowMap : public ICamera
+	{
+		math::Vertex m_light;
+		int m_size;
+		fixed m_near;
+		mutable std::vector<fixed> m_depth; // FACES maps of m_size x m_size
+
+		void renderTriangle(const math::Vertex (&world)[3]) const;
+		void renderFace(int face, const math::Vertex (&world)[3]) const;
+
+	public:
+		enum { FACES = 6 };
+
+		// zNear is the distance from the light, at which the geometry
+		// is clipped
+		ShadowMap(const math::Vertex& light, int size = 1024, const fixed& zNear = 1);
+
+		void render(const Triangle*, const math::Affine&, const Lights& lights) const override;
+		void render(const Mesh*, const math::Affine&, const Lights& lights) const override;
+		void renderLine(const math::Vertex& start, const math::Vertex& stop, const Lights& lights) const override {}
+		void beginFrame() const override;
+		void flush() const override {}
+
+		const math::Vertex& light() const { return m_light; }
+		int size() const { return m_size; }
+
+		// true, if something is closer to the light than the point
+		bool isShadowed(const math::Vertex& pt) const;
+
+		// The mask calcShadow() would make for this light: set, where
+		// the canvas shows a point in the shadow. Every pixel with a
+		// depth is taken back to the world through the camera and
+		// looked up once.
+		template <typename Canvas>
+		ShadowMaskPtr mask(const Camera& camera, const Canvas& canvas) const
+		{
+			auto shadow = std::make_shared<ShadowMask>(canvas.m_width, canvas.m_height);
+			for (int y = 0; y < canvas.m_height; ++y)
+			{
+				for (int x = 0; x < canvas.m_width; ++x)
+				{
+					if (!canvas.hasDepth(x, y))
+						continue;
+					auto pt = camera.unproject(canvas.revTr({ fixed(x), fixed(y) }), canvas.getDepth(x, y));
+					if (isShadowed(pt))
+						shadow->set(x, y);
+				}
+			}
+			return shadow;
+		}
+	};
+}
+
+#endif //__LIBSTUDIO_SHADOW_MAP_HPP__
\ No newline at end of file
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __LIBSTUDIO_SIMD_HPP__
+#define __LIBSTUDIO_SIMD_HPP__
+
+#include "fundamentals.hpp"
+#include <memory>
+#include <stdlib.h>
+
+// STUDIO_SIMD_SSE and STUDIO_SIMD_AVX tell, which instruction sets the
+// compiler is allowed to use here. Define STUDIO_NO_SIMD to force the
+// scalar code everywhere.
+#if !defined(STUDIO_NO_SIMD)
+#  if defined(__AVX__)
+#    define STUDIO_SIMD_AVX
+#  endif
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(STUDIO_SIMD_AVX)
+#    define STUDIO_SIMD_SSE
+#  endif
+#endif
+
+#if defined(STUDIO_SIMD_AVX)
+#include <immintrin.h>
+#elif defined(STUDIO_SIMD_SSE)
+#include <emmintrin.h>
+#endif
+
+namespace studio
+{
+	namespace simd
+	{
+		// Four fixed values in one register: __m128 for the float
+		// policy, __m256d for the double policy (AVX only) and a plain
+		// array otherwise. One vec4 holds exactly one Vertex, Vector or
+		// one row of a Matrix.
+#if defined(STUDIO_FIXED_FLOAT) && defined(STUDIO_SIMD_SSE)
+#define STUDIO_SIMD_VEC4
+		struct vec4
+		{
+			__m128 v;
+
+			static vec4 load(const fixed* p) { vec4 r; r.v = _mm_loadu_ps(reinterpret_cast<const float*>(p)); return r; }
+			static vec4 splat(const fixed& f) { vec4 r; r.v = _mm_set1_ps(f.v); return r; }
+			static vec4 set(const fixed& x, const fixed& y, const fixed& z, const fixed& w) { vec4 r; r.v = _mm_setr_ps(x.v, y.v, z.v, w.v); return r; }
+			void store(fixed* p) const { _mm_storeu_ps(reinterpret_cast<float*>(p), v); }
+
+			friend vec4 operator + (const vec4& lhs, const vec4& rhs) { vec4 r; r.v = _mm_add_ps(lhs.v, rhs.v); return r; }
+			friend vec4 operator * (const vec4& lhs, const vec4& rhs) { vec4 r; r.v = _mm_mul_ps(lhs.v, rhs.v); return r; }
+		};
+		static_assert(sizeof(fixed) == sizeof(float), "fixed must be a bare float for SSE loads");
+#elif defined(STUDIO_FIXED_DOUBLE) && defined(STUDIO_SIMD_AVX)
+#define STUDIO_SIMD_VEC4
+		struct vec4
+		{
+			__m256d v;
+
+			static vec4 load(const fixed* p) { vec4 r; r.v = _mm256_loadu_pd(reinterpret_cast<const double*>(p)); return r; }
+			static vec4 splat(const fixed& f) { vec4 r; r.v = _mm256_set1_pd(f.v); return r; }
+			static vec4 set(const fixed& x, const fixed& y, const fixed& z, const fixed& w) { vec4 r; r.v = _mm256_setr_pd(x.v, y.v, z.v, w.v); return r; }
+			void store(fixed* p) const { _mm256_storeu_pd(reinterpret_cast<double*>(p), v); }
+
+			friend vec4 operator + (const vec4& lhs, const vec4& rhs) { vec4 r; r.v = _mm256_add_pd(lhs.v, rhs.v); return r; }
+			friend vec4 operator * (const vec4& lhs, const vec4& rhs) { vec4 r; r.v = _mm256_mul_pd(lhs.v, rhs.v); return r; }
+		};
+		static_assert(sizeof(fixed) == sizeof(double), "fixed must be a bare double for AVX loads");
+#else
+		struct vec4
+		{
+			fixed v[4];
+
+			static vec4 load(const fixed* p) { return set(p[0], p[1], p[2], p[3]); }
+			static vec4 splat(const fixed& f) { return set(f, f, f, f); }
+			static vec4 set(const fixed& x, const fixed& y, const fixed& z, const fixed& w)
+			{
+				vec4 r;
+				r.v[0] = x;
+				r.v[1] = y;
+				r.v[2] = z;
+				r.v[3] = w;
+				return r;
+			}
+			void store(fixed* p) const
+			{
+				for (int i = 0; i < 4; ++i)
+					p[i] = v[i];
+			}
+
+			friend vec4 operator + (const vec4& lhs, const vec4& rhs) { return set(lhs.v[0] + rhs.v[0], lhs.v[1] + rhs.v[1], lhs.v[2] + rhs.v[2], lhs.v[3] + rhs.v[3]); }
+			friend vec4 operator * (const vec4& lhs, const vec4& rhs) { return set(lhs.v[0] * rhs.v[0], lhs.v[1] * rhs.v[1], lhs.v[2] * rhs.v[2], lhs.v[3] * rhs.v[3]); }
+		};
+#endif
+
+		// As many fixed values as fit one register, for the
+		// structure-of-arrays kernels. Loads and stores expect memory
+		// aligned to simd::alignment (see aligned_buffer).
+#if defined(STUDIO_FIXED_FLOAT) && defined(STUDIO_SIMD_AVX)
+#define STUDIO_SIMD_PACK
+		struct pack
+		{
+			enum { width = 8 };
+			__m256 v;
+
+			static pack load(const fixed* p) { pack r; r.v = _mm256_load_ps(reinterpret_cast<const float*>(p)); return r; }
+			static pack splat(const fixed& f) { pack r; r.v = _mm256_set1_ps(f.v); return r; }
+			void store(fixed* p) const { _mm256_store_ps(reinterpret_cast<float*>(p), v); }
+
+			friend pack operator + (const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_add_ps(lhs.v, rhs.v); return r; }
+			friend pack operator - (const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_sub_ps(lhs.v, rhs.v); return r; }
+			friend pack operator * (const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_mul_ps(lhs.v, rhs.v); return r; }
+			friend pack operator / (const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_div_ps(lhs.v, rhs.v); return r; }
+			friend pack min(const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_min_ps(lhs.v, rhs.v); return r; }
+			friend pack max(const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_max_ps(lhs.v, rhs.v); return r; }
+			// one Newton-Raphson step takes the estimate to full precision
+			friend pack rsqrt(const pack& x)
+			{
+				auto r = _mm256_rsqrt_ps(x.v);
+				auto rr = _mm256_mul_ps(_mm256_mul_ps(x.v, r), r);
+				pack out; out.v = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), r), _mm256_sub_ps(_mm256_set1_ps(3.0f), rr)); return out;
+			}
+			fixed sum() const
+			{
+				auto s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+				s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+				s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+				return fixed::fromValue(_mm_cvtss_f32(s));
+			}
+		};
+#elif defined(STUDIO_FIXED_FLOAT) && defined(STUDIO_SIMD_SSE)
+#define STUDIO_SIMD_PACK
+		struct pack
+		{
+			enum { width = 4 };
+			__m128 v;
+
+			static pack load(const fixed* p) { pack r; r.v = _mm_load_ps(reinterpret_cast<const float*>(p)); return r; }
+			static pack splat(const fixed& f) { pack r; r.v = _mm_set1_ps(f.v); return r; }
+			void store(fixed* p) const { _mm_store_ps(reinterpret_cast<float*>(p), v); }
+
+			friend pack operator + (const pack& lhs, const pack& rhs) { pack r; r.v = _mm_add_ps(lhs.v, rhs.v); return r; }
+			friend pack operator - (const pack& lhs, const pack& rhs) { pack r; r.v = _mm_sub_ps(lhs.v, rhs.v); return r; }
+			friend pack operator * (const pack& lhs, const pack& rhs) { pack r; r.v = _mm_mul_ps(lhs.v, rhs.v); return r; }
+			friend pack operator / (const pack& lhs, const pack& rhs) { pack r; r.v = _mm_div_ps(lhs.v, rhs.v); return r; }
+			friend pack min(const pack& lhs, const pack& rhs) { pack r; r.v = _mm_min_ps(lhs.v, rhs.v); return r; }
+			friend pack max(const pack& lhs, const pack& rhs) { pack r; r.v = _mm_max_ps(lhs.v, rhs.v); return r; }
+			// one Newton-Raphson step takes the estimate to full precision
+			friend pack rsqrt(const pack& x)
+			{
+				auto r = _mm_rsqrt_ps(x.v);
+				auto rr = _mm_mul_ps(_mm_mul_ps(x.v, r), r);
+				pack out; out.v = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r), _mm_sub_ps(_mm_set1_ps(3.0f), rr)); return out;
+			}
+			fixed sum() const
+			{
+				auto s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+				s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+				return fixed::fromValue(_mm_cvtss_f32(s));
+			}
+		};
+#elif defined(STUDIO_FIXED_DOUBLE) && defined(STUDIO_SIMD_AVX)
+#define STUDIO_SIMD_PACK
+		struct pack
+		{
+			enum { width = 4 };
+			__m256d v;
+
+			static pack load(const fixed* p) { pack r; r.v = _mm256_load_pd(reinterpret_cast<const double*>(p)); return r; }
+			static pack splat(const fixed& f) { pack r; r.v = _mm256_set1_pd(f.v); return r; }
+			void store(fixed* p) const { _mm256_store_pd(reinterpret_cast<double*>(p), v); }
+
+			friend pack operator + (const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_add_pd(lhs.v, rhs.v); return r; }
+			friend pack operator - (const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_sub_pd(lhs.v, rhs.v); return r; }
+			friend pack operator * (const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_mul_pd(lhs.v, rhs.v); return r; }
+			friend pack operator / (const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_div_pd(lhs.v, rhs.v); return r; }
+			friend pack min(const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_min_pd(lhs.v, rhs.v); return r; }
+			friend pack max(const pack& lhs, const pack& rhs) { pack r; r.v = _mm256_max_pd(lhs.v, rhs.v); return r; }
+			// there is no estimate for doubles
+			friend pack rsqrt(const pack& x) { pack r; r.v = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_sqrt_pd(x.v)); return r; }
+			fixed sum() const
+			{
+				auto s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+				s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+				return fixed::fromValue(_mm_cvtsd_f64(s));
+			}
+		};
+#elif defined(STUDIO_FIXED_DOUBLE) && defined(STUDIO_SIMD_SSE)
+#define STUDIO_SIMD_PACK
+		struct pack
+		{
+			enum { width = 2 };
+			__m128d v;
+
+			static pack load(const fixed* p) { pack r; r.v = _mm_load_pd(reinterpret_cast<const double*>(p)); return r; }
+			static pack splat(const fixed& f) { pack r; r.v = _mm_set1_pd(f.v); return r; }
+			void store(fixed* p) const { _mm_store_pd(reinterpret_cast<double*>(p), v); }
+
+			friend pack operator + (const pack& lhs, const pack& rhs) { pack r; r.v = _mm_add_pd(lhs.v, rhs.v); return r; }
+			friend pack operator - (const pack& lhs, const pack& rhs) { pack r; r.v = _mm_sub_pd(lhs.v, rhs.v); return r; }
+			friend pack operator * (const pack& lhs, const pack& rhs) { pack r; r.v = _mm_mul_pd(lhs.v, rhs.v); return r; }
+			friend pack operator / (const pack& lhs, const pack& rhs) { pack r; r.v = _mm_div_pd(lhs.v, rhs.v); return r; }
+			friend pack min(const pack& lhs, const pack& rhs) { pack r; r.v = _mm_min_pd(lhs.v, rhs.v); return r; }
+			friend pack max(const pack& lhs, const pack& rhs) { pack r; r.v = _mm_max_pd(lhs.v, rhs.v); return r; }
+			// there is no estimate for doubles
+			friend pack rsqrt(const pack& x) { pack r; r.v = _mm_div_pd(_mm_set1_pd(1.0), _mm_sqrt_pd(x.v)); return r; }
+			fixed sum() const { return fixed::fromValue(_mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)))); }
+		};
+#else
+		struct pack
+		{
+			enum { width = 1 };
+			fixed v;
+
+			static pack load(const fixed* p) { pack r; r.v = *p; return r; }
+			static pack splat(const fixed& f) { pack r; r.v = f; return r; }
+			void store(fixed* p) const { *p = v; }
+
+			friend pack operator + (const pack& lhs, const pack& rhs) { pack r; r.v = lhs.v + rhs.v; return r; }
+			friend pack operator - (const pack& lhs, const pack& rhs) { pack r; r.v = lhs.v - rhs.v; return r; }
+			friend pack operator * (const pack& lhs, const pack& rhs) { pack r; r.v = lhs.v * rhs.v; return r; }
+			friend pack operator / (const pack& lhs, const pack& rhs) { pack r; r.v = lhs.v / rhs.v; return r; }
+			friend pack min(const pack& lhs, const pack& rhs) { return lhs.v < rhs.v ? lhs : rhs; }
+			friend pack max(const pack& lhs, const pack& rhs) { return lhs.v < rhs.v ? rhs : lhs; }
+			friend pack rsqrt(const pack& x) { pack r; r.v = fixed(1) / sqrt(x.v); return r; }
+			fixed sum() const { return v; }
+		};
+#endif
+
+		enum { alignment = 32 };
+
+		inline size_t padded(size_t count)
+		{
+			return (count + pack::width - 1) / pack::width * pack::width;
+		}
+
+		// Growable array aligned for pack loads. The capacity is always
+		// a multiple of the pack width, so the kernels never need a
+		// scalar tail.
+		template <typename T>
+		class aligned_buffer
+		{
+			T* m_data;
+			size_t m_size;
+			size_t m_capacity;
+
+			aligned_buffer(const aligned_buffer&);
+			aligned_buffer& operator = (const aligned_buffer&);
+
+			static T* allocate(size_t count)
+			{
+#ifdef STUDIO_SIMD_SSE
+				return static_cast<T*>(_mm_malloc(count * sizeof(T), alignment));
+#else
+				return static_cast<T*>(malloc(count * sizeof(T)));
+#endif
+			}
+
+			static void deallocate(T* ptr)
+			{
+#ifdef STUDIO_SIMD_SSE
+				_mm_free(ptr);
+#else
+				free(ptr);
+#endif
+			}
+		public:
+			aligned_buffer() : m_data(nullptr), m_size(0), m_capacity(0) {}
+			explicit aligned_buffer(size_t count) : m_data(nullptr), m_size(0), m_capacity(0) { resize(count); }
+			~aligned_buffer() { deallocate(m_data); }
+
+			void resize(size_t count)
+			{
+				m_size = count;
+				auto capacity = padded(count);
+				if (capacity <= m_capacity)
+					return;
+
+				deallocate(m_data);
+				m_data = allocate(capacity);
+				m_capacity = capacity;
+				std::uninitialized_fill(m_data, m_data + m_capacity, T());
+			}
+
+			size_t size() const { return m_size; }
+			size_t capacity() const { return m_capacity; }
+			T* data() { return m_data; }
+			const T* data() const { return m_data; }
+			T& operator[](size_t i) { return m_data[i]; }
+			const T& operator[](size_t i) const { return m_data[i]; }
+		};
+	}
+}
+
+#endif //__LIBSTUDIO_SIMD_HPP__
\ No newline at end of file
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __LIBSTUDIO_THREAD_POOL_HPP__
+#define __LIBSTUDIO_THREAD_POOL_HPP__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+
+namespace studio
+{
+	class ThreadPool
+	{
+		std::vector<std::thread> m_threads;
+		std::deque<std::function<void()>> m_tasks;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		bool m_stop;
+
+		ThreadPool(const ThreadPool&);
+		ThreadPool& operator = (const ThreadPool&);
+
+		void worker();
+	public:
+		explicit ThreadPool(size_t threads);
+		~ThreadPool();
+
+		// shared by the whole library; one thread per core, the calling
+		// thread being one of them
+		static ThreadPool& instance();
+
+		size_t size() const { return m_threads.size(); }
+		void run(std::function<void()> task);
+
+		// Calls f(i) for every i in [0, count) and returns, when all the
+		// calls are done. The calling thread takes part in the loop and
+		// only waits for the helpers which have already started; helpers
+		// still queued when it runs out of indices (e.g. behind tasks
+		// blocked in their own parallel_for) quit without a call, so it
+		// is safe to call it from inside one of the tasks.
+		template <typename F>
+		void parallel_for(size_t count, const F& f)
+		{
+			if (!count)
+				return;
+
+			// outlives the call: a late helper still reads closed
+			struct Latch
+			{
+				std::mutex mutex;
+				std::condition_variable done;
+				size_t running;
+				bool closed;
+				std::atomic<size_t> next;
+			};
+			auto latch = std::make_shared<Latch>();
+			latch->running = 0;
+			latch->closed = false;
+			latch->next = 0;
+
+			auto fn = &f;
+			auto body = [=]
+			{
+				size_t i;
+				while ((i = latch->next++) < count)
+					(*fn)(i);
+			};
+
+			auto helpers = std::min(count, size() + 1) - 1;
+			for (size_t helper = 0; helper < helpers; ++helper)
+			{
+				run([=]
+				{
+					{
+						std::lock_guard<std::mutex> lock(latch->mutex);
+						if (latch->closed)
+							return;
+						++latch->running;
+					}
+					body();
+					std::lock_guard<std::mutex> lock(latch->mutex);
+					if (!--latch->running)
+						latch->done.notify_one();
+				});
+			}
+
+			body();
+
+			std::unique_lock<std::mutex> lock(latch->mutex);
+			latch->closed = true;
+			latch->done.wait(lock, [&] { return !latch->running; });
+		}
+	};
+}
+
+#endif //__LIBSTUDIO_THREAD_POOL_HPP__
\ No newline at end of file
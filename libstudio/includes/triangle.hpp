@@ -35,8 +35,15 @@ namespace studio
 		typedef math::Vertex vertices_t[3];
 
 		Triangle(const math::Vertex& v1, const math::Vertex& v2, const math::Vertex& v3);
-		void renderTo(const ICamera* cam, const math::Matrix& parent, const Lights& lights) const override;
+		void renderTo(const ICamera* cam, const math::Affine& parent, const Lights& lights) const override;
 		MaterialPtr material() const override { return m_material; }
+		Bounds bounds() const override
+		{
+			Bounds box;
+			for (auto && vertex : m_vertices)
+				box.add(vertex);
+			return box;
+		}
 
 		const vertices_t& vertices() const { return m_vertices; }
 		math::Vector normal() const { return math::Vector::crossProduct(m_vertices[2] - m_vertices[1], m_vertices[0] - m_vertices[1]); }
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __LIBSTUDIO_VERTEX_STREAM_HPP__
+#define __LIBSTUDIO_VERTEX_STREAM_HPP__
+
+#include "fundamentals.hpp"
+#include "simd.hpp"
+
+namespace studio
+{
+	namespace math
+	{
+		// Structure-of-arrays copy of a vertex list. Every coordinate
+		// lives in its own aligned array padded to the pack width, so
+		// the transform and projection run one pack of vertices per
+		// instruction instead of one vertex at a time.
+		class VertexStream
+		{
+			simd::aligned_buffer<fixed> m_x, m_y, m_z;
+			simd::aligned_buffer<fixed> m_px, m_py;
+			size_t m_size;
+
+		public:
+			VertexStream() : m_size(0) {}
+			explicit VertexStream(size_t count) : m_size(0) { resize(count); }
+
+			void resize(size_t count);
+			void assign(const Vertex* points, size_t count);
+			size_t size() const { return m_size; }
+
+			void set(size_t i, const Vertex& pt)
+			{
+				m_x[i] = pt.x();
+				m_y[i] = pt.y();
+				m_z[i] = pt.z();
+			}
+
+			Vertex vertex(size_t i) const { return { m_x[i], m_y[i], m_z[i] }; }
+			Point point(size_t i) const { return { m_px[i], m_py[i] }; }
+			const fixed& z(size_t i) const { return m_z[i]; }
+
+			// points are taken as positions (w = 1)
+			void transform(const Affine& m);
+			// fills the projected arrays: other * (eye / (eye + z))
+			void project(const fixed& eye);
+		};
+	}
+}
+
+#endif //__LIBSTUDIO_VERTEX_STREAM_HPP__
\ No newline at end of file
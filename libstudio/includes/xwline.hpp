@@ -48,6 +48,60 @@ namespace studio
 		static inline fixed rfpart(const fixed& d) { return 1.0l - fpart(d); }
 		static inline fixed abs(const fixed& d) { return d < 0 ? -d : d; }
 
+		// Cohen-Sutherland outcodes and clipping against the bitmap, with
+		// a pixel to spare for the antialiased edge
+		enum { INSIDE = 0, LEFT = 1, RIGHT = 2, ABOVE = 4, BELOW = 8 };
+
+		int outcode(const fixed& x, const fixed& y) const
+		{
+			int code = INSIDE;
+			if (x < -1) code |= LEFT;
+			else if (x > ref.m_width) code |= RIGHT;
+			if (y < -1) code |= ABOVE;
+			else if (y > ref.m_height) code |= BELOW;
+			return code;
+		}
+
+		// false, if nothing of the line is left
+		bool clip(fixed& x0, fixed& y0, fixed& z0, fixed& x1, fixed& y1, fixed& z1) const
+		{
+			auto code0 = outcode(x0, y0);
+			auto code1 = outcode(x1, y1);
+			while (code0 | code1)
+			{
+				if (code0 & code1)
+					return false;
+
+				auto code = code0 ? code0 : code1;
+				fixed x, y, t;
+				if (code & (ABOVE | BELOW))
+				{
+					y = code & ABOVE ? fixed(-1) : fixed(ref.m_height);
+					t = (y - y0) / (y1 - y0);
+					x = x0 + (x1 - x0) * t;
+				}
+				else
+				{
+					x = code & LEFT ? fixed(-1) : fixed(ref.m_width);
+					t = (x - x0) / (x1 - x0);
+					y = y0 + (y1 - y0) * t;
+				}
+				auto z = z0 + (z1 - z0) * t;
+
+				if (code == code0)
+				{
+					x0 = x; y0 = y; z0 = z;
+					code0 = outcode(x0, y0);
+				}
+				else
+				{
+					x1 = x; y1 = y; z1 = z;
+					code1 = outcode(x1, y1);
+				}
+			}
+			return true;
+		}
+
 		// main API
 		void draw(const math::Point& start, const math::Point& stop, const fixed& _startDepth, const fixed& _stopDepth)
 		{
@@ -58,6 +112,9 @@ namespace studio
 			auto startDepth = _startDepth;
 			auto stopDepth = _stopDepth;
 
+			if (!clip(x0, y0, startDepth, x1, y1, stopDepth))
+				return;
+
 			auto steep = abs(y1 - y0) > abs(x1 - x0);
 
 			if (steep)
@@ -24,20 +24,19 @@
 
 #include "pch.h"
 #include "block.hpp"
-#include "triangle.hpp"
 
 namespace studio
 {
-	static void make_rect(Block* b, const math::Vertex& tl, const math::Vertex& tr, const math::Vertex& br, const math::Vertex& bl)
+	static void make_rect(Block* b, u32 tl, u32 tr, u32 br, u32 bl)
 	{
-		b->add<Triangle>(tl, tr, br);
-		b->add<Triangle>(br, bl, tl);
+		b->addFace(tl, tr, br);
+		b->addFace(br, bl, tl);
 	}
 
 	Block::Block(const fixed& width, const fixed& height, const fixed& depth)
 	{
-		math::Vertex a(0, 0, 0), b(width, 0, 0), c(width, height, 0), d(0, height, 0),
-			e(0, 0, depth), f(width, 0, depth), g(width, height, depth), h(0, height, depth);
+		u32 a = addVertex({ 0, 0, 0 }), b = addVertex({ width, 0, 0 }), c = addVertex({ width, height, 0 }), d = addVertex({ 0, height, 0 }),
+			e = addVertex({ 0, 0, depth }), f = addVertex({ width, 0, depth }), g = addVertex({ width, height, depth }), h = addVertex({ 0, height, depth });
 
 		make_rect(this, d, c, b, a);
 		make_rect(this, c, g, f, b);
@@ -49,7 +48,6 @@ namespace studio
 
 	void Block::setMaterialForSide(int side, const MaterialPtr& material)
 	{
-		((Triangle*) m_children[side * 2].get())->setMaterial(material);
-		((Triangle*) m_children[side * 2 + 1].get())->setMaterial(material);
+		setMaterial(side * 2, 2, material);
 	}
 }
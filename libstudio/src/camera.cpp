@@ -25,68 +25,338 @@
 #include "pch.h"
 #include "camera.hpp"
 #include "triangle.hpp"
+#include "mesh.hpp"
 #include <stdlib.h>
 #include <memory.h>
 #include <iomanip>
+#include <atomic>
 
 namespace studio
 {
-	void Camera::transform(math::Vertex& pt, const math::Matrix& local) const
+	void Camera::transform(math::Vertex& pt, const math::Affine& local) const
 	{
-		pt = local * pt;
+		transform(&pt, 1, local);
+	}
 
-		pt.x() -= m_position.x();
-		pt.y() -= m_position.y();
-		pt.z() -= m_position.z();
+	void Camera::transform(math::Vertex* points, size_t count, const math::Affine& local) const
+	{
+		// the camera offset is folded into the matrix, so the whole array
+		// goes through a single kernel call
+		auto view = math::Affine::translate(-m_position.x(), -m_position.y(), -m_position.z()) * local;
+		view.transform(points, points, count);
 
 		//TODO: apply pitch and yaw as resulting from m_target
 	}
 
-	static int round(long double ld)
+	void Camera::transform(math::VertexStream& stream, const math::Affine& local) const
 	{
-		if (ld < 0)
-			return (int) (ld - 0.5);
-		return (int) (ld + 0.5);
+		stream.transform(math::Affine::translate(-m_position.x(), -m_position.y(), -m_position.z()) * local);
 	}
 
-	void Camera::render(const Triangle* triangle, const math::Matrix& local, const Lights& lights) const
+	void Camera::beginFrame() const
 	{
-		Triangle::vertices_t vertices;
+		// frame numbers are unique across all the cameras; 0 is left for
+		// a camera which never started a frame
+		static std::atomic<unsigned> frames(0);
+		m_frame = ++frames;
+		m_stats = CullStats();
+	}
+
+	void Camera::flush() const
+	{
+		if (m_canvas)
+			m_canvas->flush();
+	}
+
+	void Camera::updateLights(const Lights& lights) const
+	{
+		// the scene hands the same lights to every object of a frame;
+		// outside of beginFrame() nothing is cached
+		if (m_frame && m_lightsFrame == m_frame)
+			return;
+		m_lightsFrame = m_frame;
+
+		std::vector<LightCache::Source> sources;
+		sources.reserve(lights.size());
+		for (auto && light : lights)
 		{
-			math::Vertex* pt = vertices;
-			for (auto && vertex : triangle->vertices())
-				*pt++ = vertex;
+			LightCache::Source source;
+			source.position = light->position();
+			transform(source.position, math::Affine::identity());
+			source.power = light->power();
+			source.radius = light->radius();
+
+			// the screen rectangle is the projected box around the
+			// light's sphere; a sphere reaching behind the eye may
+			// reach anything
+			auto r = source.radius;
+			source.bounded = r > 0 && m_eye + source.position.z() - r > 0;
+			if (source.bounded)
+			{
+				source.minX = source.minY = fixed::max();
+				source.maxX = source.maxY = fixed::lowest();
+				for (int corner = 0; corner < 8; ++corner)
+				{
+					auto pt = project(source.position + math::Vertex(corner & 1 ? r : -r, corner & 2 ? r : -r, corner & 4 ? r : -r));
+					source.minX = std::min(source.minX, pt.x());
+					source.minY = std::min(source.minY, pt.y());
+					source.maxX = std::max(source.maxX, pt.x());
+					source.maxY = std::max(source.maxY, pt.y());
+				}
+			}
+			sources.push_back(source);
 		}
-		transformPoints(vertices, local);
+		m_lights = std::make_shared<LightCache>(sources, m_canvas ? m_canvas->width() : 0, m_canvas ? m_canvas->height() : 0);
+	}
 
-#if 0
-		auto cosTh = math::Vector::cosTheta(
-			Triangle(vertices[0], vertices[1], vertices[2]).normal(),
-			vertices[1] - m_position
-			);
+	// Planes the faces and lines are clipped against, in the camera
+	// space, where w = eye + z is the distance from the eye along the
+	// view axis. Behind the near plane the projection blows up; the four
+	// guard band planes keep the projected points within GUARD_BAND
+	// pixels from the centre of the canvas, which every rasterizer can
+	// step through and every fixed point format can hold. The distance
+	// is not negative on the inside.
+	enum { NEAR_PLANE = 1, GUARD_BAND = 8192, CLIP_PLANES = 5, MAX_CORNERS = 3 + CLIP_PLANES };
+
+	static fixed clipDistance(int plane, const math::Vertex& pt, const fixed& eye, const fixed& guardX, const fixed& guardY)
+	{
+		auto w = eye + pt.z();
+		switch (plane)
 		{
-			auto normal = Triangle(vertices[0], vertices[1], vertices[2]).normal();
+		case 0: return w - NEAR_PLANE;
+		case 1: return guardX * w + pt.x();
+		case 2: return guardX * w - pt.x();
+		case 3: return guardY * w + pt.y();
+		default:
+			break;
+		}
+		return guardY * w - pt.y();
+	}
 
-			wchar_t buffer[300];
-			swprintf_s(buffer, L"<%d, %d, %d>", round(normal.i()), round(normal.j()), round(normal.k()));
+	static fixed clipDistance(int plane, const math::Vertex& pt, const fixed& eye, const fixed& guard)
+	{
+		return clipDistance(plane, pt, eye, guard, guard);
+	}
 
-			auto midpoint = ((vertices[0] + vertices[2]) / 2);// +vertices[1]) / 2;
-			auto textPos = midpoint + normal / (normal.length() / 400);
-			m_canvas->line(project(midpoint), project(midpoint + normal / (normal.length() / 150)));
+	static math::Vertex lerp(const math::Vertex& a, const math::Vertex& b, const fixed& t)
+	{
+		return { a.x() + (b.x() - a.x()) * t, a.y() + (b.y() - a.y()) * t, a.z() + (b.z() - a.z()) * t };
+	}
 
-			//m_canvas->text(project(textPos), buffer);
-			normal = vertices[1] - m_position;
-			m_canvas->line(project(midpoint), { 0, 0 });
+	bool Camera::isBackFacing(const math::Vertex (&vertices)[3]) const
+	{
+		// the eye is at (0, 0, -eye) in the camera space; a face is seen
+		// from the back, if the eye is behind the plane of the face
+		auto normal = Triangle(vertices[0], vertices[1], vertices[2]).normal();
+		auto toFace = vertices[0] - math::Vertex(0, 0, -m_eye);
+		return normal.i() * toFace.i() + normal.j() * toFace.j() + normal.k() * toFace.k() > 0;
+	}
+
+	bool Camera::isOffScreen(const math::Point* points, int count) const
+	{
+		auto halfW = fixed(m_canvas->width()) / 2;
+		auto halfH = fixed(m_canvas->height()) / 2;
+		int left = 0, right = 0, above = 0, below = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			auto && pt = points[i];
+			if (pt.x() < -halfW) ++left;
+			if (pt.x() > halfW) ++right;
+			if (pt.y() < -halfH) ++above;
+			if (pt.y() > halfH) ++below;
 		}
-#endif
+		return left == count || right == count || above == count || below == count;
+	}
 
-		math::Point points [sizeof(vertices)/sizeof(vertices[0])];
-		project(points, vertices);
+	bool Camera::isVisible(const Renderable* object, const math::Affine& local) const
+	{
+		if (!m_canvas)
+			return true;
 
-		std::cout << "." << std::flush;
+		auto box = object->bounds();
+		if (box.empty)
+		{
+			++m_stats.hidden;
+			return false;
+		}
 
-		if (m_canvas)
-		switch (m_canvas->getRenderType())
+		math::Vertex corners[8];
+		box.corners(corners);
+		transform(corners, 8, local);
+
+		// the frustum: the same planes as clipping, only cut down to the
+		// edges of the canvas; a box with all the corners outside of any
+		// of them cannot be seen
+		auto edgeX = fixed(m_canvas->width()) / 2 / m_eye;
+		auto edgeY = fixed(m_canvas->height()) / 2 / m_eye;
+		for (int plane = 0; plane < CLIP_PLANES; ++plane)
+		{
+			bool outside = true;
+			for (auto && corner : corners)
+				outside &= clipDistance(plane, corner, m_eye, edgeX, edgeY) < 0;
+			if (outside)
+			{
+				++m_stats.hidden;
+				return false;
+			}
+		}
+
+		// the depth buffer: only for a box in front of the near plane,
+		// or its projection would mean nothing
+		math::Point lo { fixed::max(), fixed::max() };
+		math::Point hi { fixed::lowest(), fixed::lowest() };
+		auto nearest = fixed::max();
+		for (auto && corner : corners)
+		{
+			if (clipDistance(0, corner, m_eye, edgeX, edgeY) < 0)
+				return true;
+			auto pt = project(corner);
+			lo = { std::min(lo.x(), pt.x()), std::min(lo.y(), pt.y()) };
+			hi = { std::max(hi.x(), pt.x()), std::max(hi.y(), pt.y()) };
+			nearest = std::min(nearest, corner.z());
+		}
+
+		if (m_canvas->isOccluded(lo, hi, nearest))
+		{
+			++m_stats.hidden;
+			return false;
+		}
+		return true;
+	}
+
+	int Camera::clip(math::Vertex* polygon, int count) const
+	{
+		auto guard = fixed((int) GUARD_BAND) / m_eye;
+		math::Vertex scratch[MAX_CORNERS];
+		fixed distance[MAX_CORNERS];
+
+		// Sutherland-Hodgman, one plane after another; every plane may add
+		// a single corner to a convex polygon
+		for (int plane = 0; plane < CLIP_PLANES && count >= 3; ++plane)
+		{
+			bool cut = false;
+			for (int i = 0; i < count; ++i)
+			{
+				distance[i] = clipDistance(plane, polygon[i], m_eye, guard);
+				cut |= distance[i] < 0;
+			}
+			if (!cut)
+				continue;
+
+			int next = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				int j = (i + 1) % count;
+				if (distance[i] >= 0)
+					scratch[next++] = polygon[i];
+				if ((distance[i] < 0) != (distance[j] < 0))
+					scratch[next++] = lerp(polygon[i], polygon[j], distance[i] / (distance[i] - distance[j]));
+			}
+			std::copy(scratch, scratch + next, polygon);
+			count = next;
+		}
+		return count < 3 ? 0 : count;
+	}
+
+	void Camera::render(const Triangle* triangle, const math::Affine& local, const Lights& lights) const
+	{
+		static const u32 face[] = { 0, 1, 2 };
+
+		// a local stream; the camera keeps no scratch space of its own
+		math::VertexStream stream;
+		stream.assign(triangle->vertices(), 3);
+		transform(stream, local);
+		project(stream);
+		updateLights(lights);
+		renderFace(stream, face, triangle->material());
+	}
+
+	void Camera::render(const Mesh* mesh, const math::Affine& local, const Lights& lights) const
+	{
+		auto && vertices = mesh->vertices();
+		if (vertices.empty())
+			return;
+
+		// every vertex goes through the camera once, no matter how many
+		// faces are sharing it
+		math::VertexStream stream;
+		stream.assign(vertices.data(), vertices.size());
+		transform(stream, local);
+		project(stream);
+
+		updateLights(lights);
+		for (size_t i = 0, count = mesh->faceCount(); i < count; ++i)
+			renderFace(stream, mesh->face(i), mesh->faceMaterial(i));
+	}
+
+	void Camera::renderFace(const math::VertexStream& stream, const u32* face, const MaterialPtr& material) const
+	{
+		Triangle::vertices_t vertices;
+		math::Point points[sizeof(vertices) / sizeof(vertices[0])];
+		for (size_t i = 0; i < 3; ++i)
+		{
+			vertices[i] = stream.vertex(face[i]);
+			points[i] = stream.point(face[i]);
+		}
+
+		++m_stats.faces;
+		if (!m_canvas)
+			return;
+
+		// the wireframe shows the hidden edges, too
+		auto renderType = m_canvas->getRenderType();
+		auto filled = renderType != Render::Wireframe;
+		if (filled && isBackFacing(vertices))
+		{
+			++m_stats.backFacing;
+			return;
+		}
+
+		// the projection of the stream is only good, if the face needs
+		// no clipping; most of them do not
+		auto guard = fixed((int) GUARD_BAND) / m_eye;
+		bool inside = true;
+		for (int plane = 0; plane < CLIP_PLANES && inside; ++plane)
+		{
+			for (auto && vertex : vertices)
+				inside &= clipDistance(plane, vertex, m_eye, guard) >= 0;
+		}
+
+		if (inside)
+		{
+			if (filled && isOffScreen(points, 3))
+			{
+				++m_stats.offScreen;
+				return;
+			}
+			renderFace(vertices, points, material, renderType);
+			return;
+		}
+
+		math::Vertex polygon[MAX_CORNERS] = { vertices[0], vertices[1], vertices[2] };
+		math::Point projected[MAX_CORNERS];
+		auto count = clip(polygon, 3);
+		for (int i = 0; i < count; ++i)
+			projected[i] = project(polygon[i]);
+
+		if (!count || (filled && isOffScreen(projected, count)))
+		{
+			++m_stats.offScreen;
+			return;
+		}
+
+		++m_stats.clipped;
+		for (int i = 1; i + 1 < count; ++i)
+		{
+			Triangle::vertices_t fan = { polygon[0], polygon[i], polygon[i + 1] };
+			math::Point fanPoints[] = { projected[0], projected[i], projected[i + 1] };
+			renderFace(fan, fanPoints, material, renderType);
+		}
+	}
+
+	void Camera::renderFace(const math::Vertex (&vertices)[3], const math::Point (&points)[3], const MaterialPtr& material, Render renderType) const
+	{
+		switch (renderType)
 		{
 		case Render::Wireframe:
 			m_canvas->flood(
@@ -97,33 +367,34 @@ namespace studio
 			m_canvas->line(points[0], points[1], vertices[0].z(), vertices[1].z());
 			m_canvas->line(points[1], points[2], vertices[1].z(), vertices[2].z());
 			break;
+		case Render::Flat:
+		case Render::Gouraud:
 		case Render::Solid:
 			{
-				LightsInfo info;
-				info.m_normal = Triangle(vertices[0], vertices[1], vertices[2]).normal();
+				LightsInfo info(m_lights, Triangle(vertices[0], vertices[1], vertices[2]).normal());
 
-				for (auto && light : lights)
+				// Flat and Gouraud take the lighting at points, which may
+				// be off the screen, so they go through all the lights
+				// and not the tile lists
+				ShaderPtr shader;
+				if (renderType == Render::Flat)
 				{
-					auto pos = light->position();
-					transform(pos, math::Matrix::identity());
-					info.m_lights.emplace_back(pos, light->power());
+					auto centroid = (vertices[0] + vertices[1] + vertices[2]) / 3;
+					shader = std::make_shared<UniformShader>(lightColor(material, info.getIntensity(centroid)));
 				}
+				else if (renderType == Render::Gouraud)
+				{
+					shader = std::make_shared<GouraudShader>(material, points[0], points[1], points[2],
+						info.getIntensity(vertices[0]), info.getIntensity(vertices[1]), info.getIntensity(vertices[2]));
+				}
+				else
+					shader = std::make_shared<LightsShader>(material, std::move(info), points[0], points[1], points[2], vertices[0], vertices[1], vertices[2], m_eye);
 
-#if 0
-				auto midpoint = ((vertices[0] + vertices[2]) / 2);// +vertices[1]) / 2;
-				auto intensity = info.getIntensity(midpoint);
-				unsigned char shade = 0xFF;
-				unsigned int color = (unsigned char)(intensity * shade);
-
-				UniformShader white(color | (color << 8) | (color << 16) | (color << 24));
-#else
-				LightsShader white(triangle->material(), std::move(info), points[0], points[1], points[2], vertices[0], vertices[1], vertices[2]);
-#endif
 				m_canvas->fill(
 				{ points[0], vertices[0].z() },
 				{ points[1], vertices[1].z() },
 				{ points[2], vertices[2].z() },
-				&white
+				shader
 				);
 			}
 			break;
@@ -133,10 +404,23 @@ namespace studio
 	void Camera::renderLine(const math::Vertex& start, const math::Vertex& stop, const Lights& lights) const
 	{
 		math::Vertex vertices [2] = {start, stop};
-		transformPoints(vertices, math::Matrix::identity());
-		math::Point points[sizeof(vertices) / sizeof(vertices[0])];
-		project(points, vertices);
+		transform(vertices, 2, math::Affine::identity());
+
+		// the same planes as for the faces, only for a segment
+		auto guard = fixed((int) GUARD_BAND) / m_eye;
+		for (int plane = 0; plane < CLIP_PLANES; ++plane)
+		{
+			auto d0 = clipDistance(plane, vertices[0], m_eye, guard);
+			auto d1 = clipDistance(plane, vertices[1], m_eye, guard);
+			if (d0 < 0 && d1 < 0)
+				return;
+			if (d0 < 0)
+				vertices[0] = lerp(vertices[0], vertices[1], d0 / (d0 - d1));
+			else if (d1 < 0)
+				vertices[1] = lerp(vertices[1], vertices[0], d1 / (d1 - d0));
+		}
+
 		if (m_canvas)
-			m_canvas->line(points[0], points[1], vertices[0].z(), vertices[1].z());
+			m_canvas->line(project(vertices[0]), project(vertices[1]), vertices[0].z(), vertices[1].z());
 	}
 }
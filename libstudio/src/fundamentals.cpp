@@ -24,11 +24,162 @@
 
 #include "pch.h"
 #include "fundamentals.hpp"
+#include "simd.hpp"
 
 namespace studio
 {
 	namespace math
 	{
+		void Matrix::multiply(const Matrix& lhs, const Matrix& rhs, Matrix& out)
+		{
+			// row h of the product is the sum of the rows of rhs, each
+			// scaled by the matching element of row h of lhs
+			auto r0 = simd::vec4::load(rhs.m_data);
+			auto r1 = simd::vec4::load(rhs.m_data + 4);
+			auto r2 = simd::vec4::load(rhs.m_data + 8);
+			auto r3 = simd::vec4::load(rhs.m_data + 12);
+
+			for (size_t h = 0; h < my_height; ++h)
+			{
+				const fixed* row = lhs.m_data + h * my_width;
+				auto acc =
+					simd::vec4::splat(row[0]) * r0 +
+					simd::vec4::splat(row[1]) * r1 +
+					simd::vec4::splat(row[2]) * r2 +
+					simd::vec4::splat(row[3]) * r3;
+				acc.store(out.m_data + h * my_width);
+			}
+		}
+
+		static inline void transform4(const Matrix& m, const fixed* in, fixed* out, size_t count)
+		{
+			// the vertex is the sum of the columns of the matrix, each
+			// scaled by the matching coordinate
+			auto c0 = simd::vec4::set(m.at(0, 0), m.at(0, 1), m.at(0, 2), m.at(0, 3));
+			auto c1 = simd::vec4::set(m.at(1, 0), m.at(1, 1), m.at(1, 2), m.at(1, 3));
+			auto c2 = simd::vec4::set(m.at(2, 0), m.at(2, 1), m.at(2, 2), m.at(2, 3));
+			auto c3 = simd::vec4::set(m.at(3, 0), m.at(3, 1), m.at(3, 2), m.at(3, 3));
+
+			for (size_t i = 0; i < count; ++i, in += 4, out += 4)
+			{
+				auto acc =
+					simd::vec4::splat(in[0]) * c0 +
+					simd::vec4::splat(in[1]) * c1 +
+					simd::vec4::splat(in[2]) * c2 +
+					simd::vec4::splat(in[3]) * c3;
+				acc.store(out);
+			}
+		}
+
+		static_assert(sizeof(Vertex) == 4 * sizeof(fixed), "Vertex arrays must be packed");
+		static_assert(sizeof(Vector) == 4 * sizeof(fixed), "Vector arrays must be packed");
+
+		void Matrix::transform(const Vertex* in, Vertex* out, size_t count) const
+		{
+			if (count)
+				transform4(*this, in->data(), out->data(), count);
+		}
+
+		void Matrix::transform(const Vector* in, Vector* out, size_t count) const
+		{
+			if (count)
+				transform4(*this, in->data(), out->data(), count);
+		}
+
+		void Affine::multiply(const Affine& lhs, const Affine& rhs, Affine& out)
+		{
+			if (lhs.m_kind == Identity)
+			{
+				out = rhs;
+				return;
+			}
+
+			if (rhs.m_kind == Identity)
+			{
+				out = lhs;
+				return;
+			}
+
+			if (lhs.m_kind == Translation)
+			{
+				// the translations simply add up
+				fixed dx = lhs.m_data[3], dy = lhs.m_data[7], dz = lhs.m_data[11];
+				out = rhs;
+				out.m_data[3] += dx;
+				out.m_data[7] += dy;
+				out.m_data[11] += dz;
+				if (out.m_kind == Translation && out.m_data[3] == 0 && out.m_data[7] == 0 && out.m_data[11] == 0)
+					out.m_kind = Identity;
+				return;
+			}
+
+			if (rhs.m_kind == Translation)
+			{
+				// the linear part stays, the translation goes through it
+				fixed dx = rhs.m_data[3], dy = rhs.m_data[7], dz = rhs.m_data[11];
+				out = lhs;
+				for (size_t h = 0; h < my_height; ++h)
+				{
+					const fixed* row = lhs.m_data + h * my_width;
+					out.m_data[3 + h * my_width] = row[0] * dx + row[1] * dy + row[2] * dz + row[3];
+				}
+				return;
+			}
+
+			auto r0 = simd::vec4::load(rhs.m_data);
+			auto r1 = simd::vec4::load(rhs.m_data + 4);
+			auto r2 = simd::vec4::load(rhs.m_data + 8);
+
+			Affine tmp;
+			for (size_t h = 0; h < my_height; ++h)
+			{
+				const fixed* row = lhs.m_data + h * my_width;
+				auto acc =
+					simd::vec4::splat(row[0]) * r0 +
+					simd::vec4::splat(row[1]) * r1 +
+					simd::vec4::splat(row[2]) * r2 +
+					simd::vec4::set(0, 0, 0, row[3]);
+				acc.store(tmp.m_data + h * my_width);
+			}
+			tmp.m_kind = General;
+			out = tmp;
+		}
+
+		static inline void transform3(const Affine& m, const fixed* in, fixed* out, size_t count)
+		{
+			switch (m.kind())
+			{
+			case Affine::Identity:
+				if (in != out)
+					std::copy(in, in + 4 * count, out);
+				break;
+
+			case Affine::Translation:
+				{
+					auto t = simd::vec4::set(m.at(3, 0), m.at(3, 1), m.at(3, 2), 0);
+					for (size_t i = 0; i < count; ++i, in += 4, out += 4)
+						(simd::vec4::load(in) + t * simd::vec4::splat(in[3])).store(out);
+				}
+				break;
+
+			default:
+				transform4(m.matrix(), in, out, count);
+				break;
+			}
+		}
+
+		void Affine::transform(const Vertex* in, Vertex* out, size_t count) const
+		{
+			if (count)
+				transform3(*this, in->data(), out->data(), count);
+		}
+
+		void Affine::transform(const Vector* in, Vector* out, size_t count) const
+		{
+			if (count)
+				transform3(*this, in->data(), out->data(), count);
+		}
+
 		fixed Vector::cosTheta(const Vector& lhs, const Vector& rhs)
 		{
 			auto scalar = dotProduct(lhs, rhs);
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "pch.h"
+#include "light.hpp"
+#include <algorithm>
+
+namespace studio
+{
+	LightCache::LightCache(const std::vector<Source>& lights, int width, int height)
+		: m_size(lights.size())
+		, m_width(width)
+		, m_height(height)
+		, m_tilesX(0)
+		, m_tilesY(0)
+	{
+		m_all.offset = 0;
+		m_all.count = m_size;
+
+		// the lists are made of indices first, so the arrays can be
+		// allocated just once
+		std::vector<std::vector<u32>> lists;
+		bool bounded = false;
+		for (auto && light : lights)
+			bounded |= light.bounded;
+
+		size_t total = simd::padded(m_size);
+		if (bounded && width > 0 && height > 0)
+		{
+			m_tilesX = (width + TILE - 1) / TILE;
+			m_tilesY = (height + TILE - 1) / TILE;
+			lists.resize(m_tilesX * m_tilesY);
+
+			for (u32 i = 0; i < (u32) m_size; ++i)
+			{
+				auto && light = lights[i];
+				int x0 = 0, y0 = 0, x1 = m_tilesX - 1, y1 = m_tilesY - 1;
+				if (light.bounded)
+				{
+					x0 = std::max(x0, cast<int>(light.minX) + width / 2) / TILE;
+					y0 = std::max(y0, cast<int>(light.minY) + height / 2) / TILE;
+					x1 = std::min(x1, (cast<int>(light.maxX) + width / 2) / TILE);
+					y1 = std::min(y1, (cast<int>(light.maxY) + height / 2) / TILE);
+				}
+				for (int y = y0; y <= y1; ++y)
+					for (int x = x0; x <= x1; ++x)
+						lists[y * m_tilesX + x].push_back(i);
+			}
+
+			for (auto && list : lists)
+				if (list.size() != m_size)
+					total += simd::padded(list.size());
+		}
+
+		m_x.resize(total);
+		m_y.resize(total);
+		m_z.resize(total);
+		m_power.resize(total);
+		m_invRadiusSq.resize(total);
+
+		size_t pos = 0;
+		auto append = [&](const Source& light)
+		{
+			m_x[pos] = light.position.x();
+			m_y[pos] = light.position.y();
+			m_z[pos] = light.position.z();
+			m_power[pos] = light.power / 100;
+			if (light.radius > 0)
+			{
+				auto radius = light.radius / 1000;
+				m_invRadiusSq[pos] = 1 / (radius * radius);
+			}
+			++pos;
+		};
+
+		for (auto && light : lights)
+			append(light);
+		pos = simd::padded(pos);
+
+		if (lists.empty())
+			return;
+
+		m_tiles.resize(lists.size());
+		for (size_t tile = 0; tile < lists.size(); ++tile)
+		{
+			auto && list = lists[tile];
+			if (list.size() == m_size)
+			{
+				m_tiles[tile] = m_all;
+				continue;
+			}
+			m_tiles[tile].offset = pos;
+			m_tiles[tile].count = list.size();
+			for (auto index : list)
+				append(lights[index]);
+			pos = simd::padded(pos);
+		}
+	}
+
+	const LightCache::Range& LightCache::tile(const math::Point& pt) const
+	{
+		if (m_tiles.empty())
+			return m_all;
+
+		int x = (cast<int>(pt.x()) + m_width / 2) / TILE;
+		int y = (cast<int>(pt.y()) + m_height / 2) / TILE;
+		x = std::min(std::max(x, 0), m_tilesX - 1);
+		y = std::min(std::max(y, 0), m_tilesY - 1);
+		return m_tiles[y * m_tilesX + x];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "mesh.hpp"
+#include "camera.hpp"
+#include <algorithm>
+
+namespace studio
+{
+	Mesh::Mesh()
+	{
+		m_materials.push_back(nullptr);
+	}
+
+	u32 Mesh::addVertex(const math::Vertex& pt)
+	{
+		touch();
+		m_bounds.add(pt);
+		m_vertices.push_back(pt);
+		return (u32) (m_vertices.size() - 1);
+	}
+
+	size_t Mesh::addFace(u32 a, u32 b, u32 c)
+	{
+		touch();
+		m_indices.push_back(a);
+		m_indices.push_back(b);
+		m_indices.push_back(c);
+		m_faceMaterials.push_back(0);
+		return m_faceMaterials.size() - 1;
+	}
+
+	void Mesh::setMaterial(size_t first, size_t count, const MaterialPtr& material)
+	{
+		auto it = std::find(m_materials.begin(), m_materials.end(), material);
+		u32 index = (u32) (it - m_materials.begin());
+		if (it == m_materials.end())
+			m_materials.push_back(material);
+
+		auto last = std::min(first + count, m_faceMaterials.size());
+		for (; first < last; ++first)
+			m_faceMaterials[first] = index;
+	}
+
+	void Mesh::renderTo(const ICamera* cam, const math::Affine& parent, const Lights& lights) const
+	{
+		auto local = parent * localMatrix();
+		if (cam->isVisible(this, local))
+			cam->render(this, local, lights);
+	}
+}
\ No newline at end of file
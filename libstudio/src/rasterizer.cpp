@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "rasterizer.hpp"
+#include <cmath>
+
+namespace studio
+{
+	namespace raster
+	{
+		static inline long long snap(const fixed& v)
+		{
+			return (long long) std::floor(cast<double>(v) * SUBPIXEL + 0.5);
+		}
+
+		static inline int ceilPixel(long long v)
+		{
+			return (int) ((v + SUBPIXEL - 1) >> SUBPIXEL_BITS);
+		}
+
+		static inline int floorPixel(long long v)
+		{
+			return (int) (v >> SUBPIXEL_BITS);
+		}
+
+		bool Setup::init(const PointWithDepth (&pts)[3], int width, int height)
+		{
+			long long X[3], Y[3];
+			double Z[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				X[i] = snap(pts[i].m_pos.x());
+				Y[i] = snap(pts[i].m_pos.y());
+				Z[i] = cast<double>(pts[i].m_depth);
+			}
+
+			long long area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+			if (!area)
+				return false;
+
+			// the edge functions below are positive inside a triangle
+			// with positive area; both windings are drawn
+			if (area < 0)
+			{
+				std::swap(X[1], X[2]);
+				std::swap(Y[1], Y[2]);
+				std::swap(Z[1], Z[2]);
+				area = -area;
+			}
+
+			m_minX = std::max(ceilPixel(std::min({ X[0], X[1], X[2] })), 0);
+			m_minY = std::max(ceilPixel(std::min({ Y[0], Y[1], Y[2] })), 0);
+			m_maxX = std::min(floorPixel(std::max({ X[0], X[1], X[2] })), width - 1);
+			m_maxY = std::min(floorPixel(std::max({ Y[0], Y[1], Y[2] })), height - 1);
+			if (m_minX > m_maxX || m_minY > m_maxY)
+				return false;
+
+			for (int i = 0; i < 3; ++i)
+			{
+				int j = (i + 1) % 3;
+				Edge& e = m_edges[i];
+				e.a = Y[i] - Y[j];
+				e.b = X[j] - X[i];
+				e.c = -(e.a * X[i] + e.b * Y[i]);
+
+				// fill rule: pixels lying exactly on a right or top edge
+				// belong to the neighbouring triangle; this is the rule
+				// the scanline filler follows (first row is y0 + 1)
+				bool bottomLeft = e.a > 0 || (e.a == 0 && e.b < 0);
+				if (!bottomLeft)
+					e.c -= 1;
+			}
+
+			// depth plane through the snapped vertices, in pixels
+			double x1 = double(X[1] - X[0]) / SUBPIXEL, y1 = double(Y[1] - Y[0]) / SUBPIXEL;
+			double x2 = double(X[2] - X[0]) / SUBPIXEL, y2 = double(Y[2] - Y[0]) / SUBPIXEL;
+			double z1 = Z[1] - Z[0], z2 = Z[2] - Z[0];
+			double det = x1 * y2 - x2 * y1;
+			m_dzdx = (z1 * y2 - z2 * y1) / det;
+			m_dzdy = (z2 * x1 - z1 * x2) / det;
+			m_nearest = fixed(std::min({ Z[0], Z[1], Z[2] }));
+			m_z0 = Z[0] - m_dzdx * (double(X[0]) / SUBPIXEL) - m_dzdy * (double(Y[0]) / SUBPIXEL);
+			return true;
+		}
+	}
+}
\ No newline at end of file
@@ -29,57 +29,114 @@
 
 namespace studio
 {
-	LightsShader::LightsShader(const MaterialPtr& material, LightsInfo && info, const math::Point& p0, const math::Point& p1, const math::Point& p2, const math::Vertex& v0, const math::Vertex& v1, const math::Vertex& v2)
-		: m_material(material)
+	ScreenPlane::ScreenPlane(const math::Point (&pts)[3], const fixed& f0, const fixed& f1, const fixed& f2)
+	{
+		// the area and the products below are well out of the Q16 range
+		// for any triangle bigger than a few hundred pixels, so the setup
+		// runs in double, like raster::Setup::init does; only the plane
+		// itself goes back to fixed
+		double X0 = cast<double>(pts[0].x()), Y0 = cast<double>(pts[0].y());
+		double x1 = cast<double>(pts[1].x()) - X0, y1 = cast<double>(pts[1].y()) - Y0;
+		double x2 = cast<double>(pts[2].x()) - X0, y2 = cast<double>(pts[2].y()) - Y0;
+		double F0 = cast<double>(f0);
+		double df1 = cast<double>(f1) - F0, df2 = cast<double>(f2) - F0;
+
+		double area = x1 * y2 - x2 * y1;
+		double DX = 0, DY = 0;
+		if (area != 0)
+		{
+			DX = (df1 * y2 - df2 * y1) / area;
+			DY = (df2 * x1 - df1 * x2) / area;
+		}
+		this->f0 = fixed(F0 - X0 * DX - Y0 * DY);
+		dx = fixed(DX);
+		dy = fixed(DY);
+	}
+
+	LightsShader::LightsShader(const MaterialPtr& material, LightsInfo && info, const math::Point& p0, const math::Point& p1, const math::Point& p2, const math::Vertex& v0, const math::Vertex& v1, const math::Vertex& v2, const fixed& eye)
+		: Shader(Lights)
+		, m_material(material)
 		, m_info(std::move(info))
 	{
-		m_func[0] = ProjectedPoint(p0, v0);
-		m_func[1] = ProjectedPoint(p1, v1);
-		m_func[2] = ProjectedPoint(p2, v2);
-		std::sort(m_func, m_func + 3, [](const ProjectedPoint& lhs, const ProjectedPoint& rhs) { return lhs.y > rhs.y; });
+		// same w as in Camera::project: p = v / w
+		math::Point pts [] = { p0, p1, p2 };
+		fixed invW [] = { eye / (eye + v0.z()), eye / (eye + v1.z()), eye / (eye + v2.z()) };
 
-		A = Delta(m_func[0], m_func[2]);
-		B = Delta(m_func[0], m_func[1]);
-		C = Delta(m_func[1], m_func[2]);
+		m_invW = ScreenPlane(pts, invW[0], invW[1], invW[2]);
+		m_x3 = ScreenPlane(pts, v0.x() * invW[0], v1.x() * invW[1], v2.x() * invW[2]);
+		m_y3 = ScreenPlane(pts, v0.y() * invW[0], v1.y() * invW[1], v2.y() * invW[2]);
+		m_z3 = ScreenPlane(pts, v0.z() * invW[0], v1.z() * invW[1], v2.z() * invW[2]);
 	}
 
 	math::Vertex LightsShader::counterProject(const math::Point& pt)
 	{
-		ProjectedPoint p1, p2;
-		p1 = A.interpolate(pt.y(), m_func[0]);
-
-		if (pt.y() > m_func[1].y)
-		{
-			// the point is in the upper "half"
-			p2 = B.interpolate(pt.y(), m_func[0]);
-		}
-		else
-		{
-			// the point is in the lower "half"
-			p2 = C.interpolate(pt.y(), m_func[1]);
-		}
+		auto w = 1 / m_invW.at(pt);
+		return { m_x3.at(pt) * w, m_y3.at(pt) * w, m_z3.at(pt) * w };
+	}
 
-		auto p = Delta(p1, p2).interpolate(p1, pt.x());
+	inline u8 lit(u8 channel, const fixed& intensity)
+	{
+		auto tmp = channel * intensity;
+		if (tmp > 0xFF) tmp = 0xFF;
+		return cast<u8>(tmp);
+	}
 
-		return {p.x3, p.y3, p.z3};
+	inline Color lightColor(const Color& color, const fixed& intensity)
+	{
+		return { lit(color.R, intensity), lit(color.G, intensity), lit(color.B, intensity) };
 	}
 
-	inline void modify(Color& c, int ch, const fixed& intensity)
+	Color lightColor(const MaterialPtr& material, const fixed& intensity)
 	{
-		auto tmp = c.channel(ch) * intensity;
-		if (tmp > 0xFF) tmp = 0xFF;
-		c.channel(ch) = cast<u8>(tmp);
+		return lightColor(material ? material->color() : Color::white(), intensity);
 	}
 
 	Color LightsShader::shade(const math::Point& pt)
 	{
-		auto intensity = m_info.getIntensity(counterProject(pt));
+		return lightColor(m_material, m_info.getIntensity(counterProject(pt), pt));
+	}
+
+	void LightsShader::shadeSpan(const math::Point& start, const fixed& step, size_t count, Color* out)
+	{
+		// the planes are stepped along the row, the only per-pixel
+		// division left is the reciprocal of 1/w
+		auto invW = m_invW.at(start);
+		auto x3 = m_x3.at(start);
+		auto y3 = m_y3.at(start);
+		auto z3 = m_z3.at(start);
+		auto dInvW = m_invW.dx * step;
+		auto dx3 = m_x3.dx * step;
+		auto dy3 = m_y3.dx * step;
+		auto dz3 = m_z3.dx * step;
+
+		Color base = m_material ? m_material->color() : Color::white();
+		auto x = start.x();
+		for (size_t i = 0; i < count; ++i, x += step, invW += dInvW, x3 += dx3, y3 += dy3, z3 += dz3)
+		{
+			auto w = 1 / invW;
+			out[i] = lightColor(base, m_info.getIntensity({ x3 * w, y3 * w, z3 * w }, { x, start.y() }));
+		}
+	}
 
-		Color color = m_material ? m_material->color() : Color::white();
+	GouraudShader::GouraudShader(const MaterialPtr& material, const math::Point& p0, const math::Point& p1, const math::Point& p2, const fixed& i0, const fixed& i1, const fixed& i2)
+		: Shader(Gouraud)
+		, m_material(material)
+	{
+		math::Point pts [] = { p0, p1, p2 };
+		m_intensity = ScreenPlane(pts, i0, i1, i2);
+	}
 
-		for (int i = 0; i < Color::channels; ++i)
-			modify(color, i, intensity);
+	Color GouraudShader::shade(const math::Point& pt)
+	{
+		return lightColor(m_material, m_intensity.at(pt));
+	}
 
-		return color;
+	void GouraudShader::shadeSpan(const math::Point& start, const fixed& step, size_t count, Color* out)
+	{
+		Color base = m_material ? m_material->color() : Color::white();
+		auto intensity = m_intensity.at(start);
+		auto dIntensity = m_intensity.dx * step;
+		for (size_t i = 0; i < count; ++i, intensity += dIntensity)
+			out[i] = lightColor(base, intensity);
 	}
 }
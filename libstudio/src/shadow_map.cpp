@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "pch.h"
+#include "shadow_map.hpp"
+#include "triangle.hpp"
+#include "mesh.hpp"
+#include <algorithm>
+
+namespace studio
+{
+	enum { BIAS = 50 }; // a surface only shadows points more than 1/BIAS farther away
+
+	// The face of the cube a direction from the light falls on: the one
+	// of the axis with the largest coordinate.
+	static int faceOf(const fixed& dx, const fixed& dy, const fixed& dz)
+	{
+		auto ax = dx < 0 ? -dx : dx;
+		auto ay = dy < 0 ? -dy : dy;
+		auto az = dz < 0 ? -dz : dz;
+		if (ax >= ay && ax >= az)
+			return dx < 0 ? 1 : 0;
+		if (ay >= az)
+			return dy < 0 ? 3 : 2;
+		return dz < 0 ? 5 : 4;
+	}
+
+	struct FacePoint
+	{
+		fixed u, v;  // across the face
+		fixed depth; // along the face's axis
+	};
+
+	static FacePoint toFace(int face, const fixed& dx, const fixed& dy, const fixed& dz)
+	{
+		switch (face)
+		{
+		case 0: return { dy, dz, dx };
+		case 1: return { dy, dz, -dx };
+		case 2: return { dx, dz, dy };
+		case 3: return { dx, dz, -dy };
+		case 4: return { dx, dy, dz };
+		default:
+			break;
+		}
+		return { dx, dy, -dz };
+	}
+
+	ShadowMap::ShadowMap(const math::Vertex& light, int size, const fixed& zNear)
+		: m_light(light)
+		, m_size(size)
+		, m_near(zNear)
+		, m_depth(FACES * size * size, fixed())
+	{
+	}
+
+	void ShadowMap::beginFrame() const
+	{
+		std::fill(m_depth.begin(), m_depth.end(), fixed());
+	}
+
+	void ShadowMap::render(const Triangle* triangle, const math::Affine& local, const Lights&) const
+	{
+		math::Vertex world[3];
+		local.transform(triangle->vertices(), world, 3);
+		renderTriangle(world);
+	}
+
+	void ShadowMap::render(const Mesh* mesh, const math::Affine& local, const Lights&) const
+	{
+		// the vertex cache of the mesh is left to the real cameras, shadow
+		// maps are rendered once and may be rendered on many threads
+		auto && vertices = mesh->vertices();
+		std::vector<math::Vertex> world(vertices.size());
+		local.transform(vertices.data(), world.data(), vertices.size());
+
+		for (size_t i = 0, count = mesh->faceCount(); i < count; ++i)
+		{
+			auto face = mesh->face(i);
+			math::Vertex triangle[] = { world[face[0]], world[face[1]], world[face[2]] };
+			renderTriangle(triangle);
+		}
+	}
+
+	void ShadowMap::renderTriangle(const math::Vertex (&world)[3]) const
+	{
+		for (int face = 0; face < FACES; ++face)
+			renderFace(face, world);
+	}
+
+	void ShadowMap::renderFace(int face, const math::Vertex (&world)[3]) const
+	{
+		FacePoint in[3];
+		for (int i = 0; i < 3; ++i)
+			in[i] = toFace(face, world[i].x() - m_light.x(), world[i].y() - m_light.y(), world[i].z() - m_light.z());
+
+		// near plane clipping, one plane of Sutherland-Hodgman: a
+		// triangle comes out with three or four corners or not at all
+		FacePoint out[4];
+		int count = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			auto && a = in[i];
+			auto && b = in[(i + 1) % 3];
+			bool aInside = a.depth >= m_near;
+			bool bInside = b.depth >= m_near;
+			if (aInside)
+				out[count++] = a;
+			if (aInside != bInside)
+			{
+				auto t = (m_near - a.depth) / (b.depth - a.depth);
+				out[count++] = { a.u + (b.u - a.u) * t, a.v + (b.v - a.v) * t, m_near };
+			}
+		}
+		if (count < 3)
+			return;
+
+		// u / depth = -1..1 spans the whole map
+		auto half = fixed(m_size) / 2;
+		PointWithDepth pts[4];
+		for (int i = 0; i < count; ++i)
+			pts[i] = { { (out[i].u / out[i].depth + 1) * half, (out[i].v / out[i].depth + 1) * half }, m_near / out[i].depth };
+
+		auto map = &m_depth[face * m_size * m_size];
+		for (int i = 1; i + 1 < count; ++i)
+		{
+			PointWithDepth triangle[] = { pts[0], pts[i], pts[i + 1] };
+			raster::Setup setup;
+			if (!setup.init(triangle, m_size, m_size))
+				continue;
+
+			raster::fill(setup, [&](int x, int y, int length, fixed q, const fixed& dq) {
+				auto texel = map + y * m_size + x;
+				for (int j = 0; j < length; ++j, q += dq)
+				{
+					if (texel[j] < q)
+						texel[j] = q;
+				}
+			});
+		}
+	}
+
+	bool ShadowMap::isShadowed(const math::Vertex& pt) const
+	{
+		auto dx = pt.x() - m_light.x();
+		auto dy = pt.y() - m_light.y();
+		auto dz = pt.z() - m_light.z();
+		int face = faceOf(dx, dy, dz);
+		auto at = toFace(face, dx, dy, dz);
+		if (at.depth < m_near)
+			return false;
+
+		// the texels are sampled at their integer coordinates
+		auto half = fixed(m_size) / 2;
+		int x = cast<int>((at.u / at.depth + 1) * half + fixed(0.5));
+		int y = cast<int>((at.v / at.depth + 1) * half + fixed(0.5));
+		x = std::min(std::max(x, 0), m_size - 1);
+		y = std::min(std::max(y, 0), m_size - 1);
+
+		auto closest = m_depth[(face * m_size + y) * m_size + x];
+		auto q = m_near / at.depth;
+		return closest > q + q / BIAS;
+	}
+}
\ No newline at end of file
@@ -35,7 +35,7 @@ namespace studio
 		m_vertices[2] = v3;
 	}
 
-	void Triangle::renderTo(const ICamera* cam, const math::Matrix& parent, const Lights& lights) const
+	void Triangle::renderTo(const ICamera* cam, const math::Affine& parent, const Lights& lights) const
 	{
 		cam->render(this, parent * localMatrix(), lights);
 	}
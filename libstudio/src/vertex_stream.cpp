@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "vertex_stream.hpp"
+
+namespace studio
+{
+	namespace math
+	{
+		void VertexStream::resize(size_t count)
+		{
+			m_size = count;
+			m_x.resize(count);
+			m_y.resize(count);
+			m_z.resize(count);
+			m_px.resize(count);
+			m_py.resize(count);
+		}
+
+		void VertexStream::assign(const Vertex* points, size_t count)
+		{
+			resize(count);
+			for (size_t i = 0; i < count; ++i)
+				set(i, points[i]);
+
+			// padding lanes go through the kernels as well; keep them at
+			// the origin, so the projection never divides by garbage
+			for (size_t i = count; i < m_x.capacity(); ++i)
+				m_x[i] = m_y[i] = m_z[i] = fixed();
+		}
+
+		void VertexStream::transform(const Affine& m)
+		{
+			using simd::pack;
+
+			if (m.kind() == Affine::Identity)
+				return;
+
+			auto x = m_x.data();
+			auto y = m_y.data();
+			auto z = m_z.data();
+			auto end = x + simd::padded(m_size);
+
+			if (m.kind() == Affine::Translation)
+			{
+				auto tx = pack::splat(m.at(3, 0));
+				auto ty = pack::splat(m.at(3, 1));
+				auto tz = pack::splat(m.at(3, 2));
+				for (; x != end; x += pack::width, y += pack::width, z += pack::width)
+				{
+					(pack::load(x) + tx).store(x);
+					(pack::load(y) + ty).store(y);
+					(pack::load(z) + tz).store(z);
+				}
+				return;
+			}
+
+			pack c[3][4];
+			for (size_t row = 0; row < 3; ++row)
+				for (size_t col = 0; col < 4; ++col)
+					c[row][col] = pack::splat(m.at(col, row));
+
+			for (; x != end; x += pack::width, y += pack::width, z += pack::width)
+			{
+				auto px = pack::load(x);
+				auto py = pack::load(y);
+				auto pz = pack::load(z);
+				(c[0][0] * px + c[0][1] * py + c[0][2] * pz + c[0][3]).store(x);
+				(c[1][0] * px + c[1][1] * py + c[1][2] * pz + c[1][3]).store(y);
+				(c[2][0] * px + c[2][1] * py + c[2][2] * pz + c[2][3]).store(z);
+			}
+		}
+
+		void VertexStream::project(const fixed& eye)
+		{
+			using simd::pack;
+
+			auto x = m_x.data();
+			auto y = m_y.data();
+			auto z = m_z.data();
+			auto px = m_px.data();
+			auto py = m_py.data();
+			auto end = x + simd::padded(m_size);
+
+			auto e = pack::splat(eye);
+			for (; x != end; x += pack::width, y += pack::width, z += pack::width, px += pack::width, py += pack::width)
+			{
+				auto ratio = e / (e + pack::load(z));
+				(pack::load(x) * ratio).store(px);
+				(pack::load(y) * ratio).store(py);
+			}
+		}
+	}
+}
\ No newline at end of file
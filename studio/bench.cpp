@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2013 Marcin Zdun
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+
+#include <scene.hpp>
+#include <camera.hpp>
+#include <triangle.hpp>
+#include <mesh.hpp>
+#include <platform_api.hpp>
+#include <canvas_types.hpp>
+
+using namespace studio;
+
+void setUp(std::shared_ptr<Scene>& scene);
+void lights(const std::shared_ptr<Scene>& scene);
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock clock_type;
+
+	double elapsed_ms(const clock_type::time_point& start)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count() / 1000.0;
+	}
+
+	// The test scene flattened to world-space triangles. All the policies
+	// start from the very same numbers.
+	struct WorldTriangle
+	{
+		double v[3][3];
+	};
+
+	void flatten(std::vector<WorldTriangle>& out, const Container& node, const math::Affine& parent)
+	{
+		math::Affine accumulated = parent * node.localMatrix();
+		for (auto && child : node)
+		{
+			if (auto container = dynamic_cast<const Container*>(child.get()))
+			{
+				flatten(out, *container, accumulated);
+				continue;
+			}
+
+			if (auto mesh = dynamic_cast<const Mesh*>(child.get()))
+			{
+				math::Affine local = accumulated * mesh->localMatrix();
+				for (size_t face = 0; face < mesh->faceCount(); ++face)
+				{
+					WorldTriangle tri;
+					for (int i = 0; i < 3; ++i)
+					{
+						auto pt = local * mesh->vertices()[mesh->face(face)[i]];
+						tri.v[i][0] = cast<double>(pt.x());
+						tri.v[i][1] = cast<double>(pt.y());
+						tri.v[i][2] = cast<double>(pt.z());
+					}
+					out.push_back(tri);
+				}
+				continue;
+			}
+
+			auto triangle = dynamic_cast<const Triangle*>(child.get());
+			if (!triangle)
+				continue;
+
+			math::Affine local = accumulated * triangle->localMatrix();
+			WorldTriangle tri;
+			for (int i = 0; i < 3; ++i)
+			{
+				auto pt = local * triangle->vertices()[i];
+				tri.v[i][0] = cast<double>(pt.x());
+				tri.v[i][1] = cast<double>(pt.y());
+				tri.v[i][2] = cast<double>(pt.z());
+			}
+			out.push_back(tri);
+		}
+	}
+
+	// A depth-only copy of the camera/rasterizer hot path, instantiated
+	// for any scalar policy: 4x4 transform, perspective projection and
+	// the scanline depth interpolation of DepthBitmap::floodFill.
+	template <typename Policy>
+	class PolicyPipeline
+	{
+		typedef math::basic_fixed<Policy> F;
+
+		int m_width;
+		int m_height;
+		F m_eye;
+		F m_view[16];
+		std::vector<F> m_depth;
+
+		struct Projected
+		{
+			F x, y, z;
+		};
+
+		static bool by_y(const Projected& lhs, const Projected& rhs) { return lhs.y < rhs.y; }
+
+		Projected project(const double (&v)[3]) const
+		{
+			F in[4] = { F(v[0]), F(v[1]), F(v[2]), F(1) };
+			F out[4];
+			for (int row = 0; row < 4; ++row)
+			{
+				out[row] = F();
+				for (int col = 0; col < 4; ++col)
+					out[row] += m_view[col + row * 4] * in[col];
+			}
+
+			auto ratio = m_eye / (m_eye + out[2]);
+			Projected ret = { out[0] * ratio + m_width / 2, out[1] * ratio + m_height / 2, out[2] };
+			return ret;
+		}
+
+		void span(int y, int start, int stop, const F& z0, const F& z1)
+		{
+			if (y < 0 || y >= m_height)
+				return;
+
+			auto dz = z1 - z0;
+			int dx = stop - start;
+			for (int x = 0; x < dx; ++x)
+			{
+				int X = start + x;
+				if (X < 0 || X >= m_width)
+					continue;
+
+				auto z = z0 + F(x) / F(dx) * dz;
+				auto& dst = m_depth[y * m_width + X];
+				if (dst > z)
+					dst = z;
+			}
+		}
+
+		void half(const Projected& a0, const Projected& a1, const Projected& b0, const Projected& b1, int from, int to)
+		{
+			auto ady = a1.y - a0.y;
+			auto bdy = b1.y - b0.y;
+			for (int y = from; y < to; ++y)
+			{
+				auto ta = (F(y) - a0.y) / ady;
+				auto tb = (F(y) - b0.y) / bdy;
+				auto xa = a0.x + ta * (a1.x - a0.x);
+				auto za = a0.z + ta * (a1.z - a0.z);
+				auto xb = b0.x + tb * (b1.x - b0.x);
+				auto zb = b0.z + tb * (b1.z - b0.z);
+				if (xa > xb)
+				{
+					std::swap(xa, xb);
+					std::swap(za, zb);
+				}
+				span(y, cast<int>(xa), cast<int>(xb), za, zb);
+			}
+		}
+
+	public:
+		PolicyPipeline(int w, int h, double eye, const double (&camera)[3])
+			: m_width(w)
+			, m_height(h)
+			, m_eye(eye)
+			, m_depth(w * h)
+		{
+			for (int i = 0; i < 16; ++i)
+				m_view[i] = i % 5 ? 0 : 1;
+			m_view[3] = F(-camera[0]);
+			m_view[7] = F(-camera[1]);
+			m_view[11] = F(-camera[2]);
+		}
+
+		static const char* name() { return Policy::name(); }
+
+		void render(const std::vector<WorldTriangle>& triangles)
+		{
+			std::fill(m_depth.begin(), m_depth.end(), F::max());
+
+			for (auto && tri : triangles)
+			{
+				Projected pts[] = { project(tri.v[0]), project(tri.v[1]), project(tri.v[2]) };
+				std::sort(pts, pts + 3, by_y);
+
+				int y0 = cast<int>(pts[0].y + 1);
+				int y1 = cast<int>(pts[1].y + 1);
+				int y2 = cast<int>(pts[2].y + 1);
+				half(pts[0], pts[2], pts[0], pts[1], y0, y1);
+				half(pts[0], pts[2], pts[1], pts[2], y1, y2);
+			}
+		}
+
+		double depth(size_t i) const
+		{
+			if (m_depth[i] == F::max())
+				return -1;
+			return cast<double>(m_depth[i]);
+		}
+
+		size_t size() const { return m_depth.size(); }
+	};
+
+	template <typename Reference, typename Pipeline>
+	void compare(const char* label, const Reference& ref, const Pipeline& test, double ms, int frames)
+	{
+		double max_error = 0;
+		size_t coverage_errors = 0;
+		for (size_t i = 0; i < ref.size(); ++i)
+		{
+			auto a = ref.depth(i);
+			auto b = test.depth(i);
+			if ((a < 0) != (b < 0))
+			{
+				++coverage_errors;
+				continue;
+			}
+			if (a < 0)
+				continue;
+			auto err = a > b ? a - b : b - a;
+			if (err > max_error)
+				max_error = err;
+		}
+
+		printf("%-8s %-10s %10.2f ms/frame   max depth error %10.4f   coverage errors %8u\n",
+			label, test.name(), ms / frames, max_error, (unsigned) coverage_errors);
+	}
+
+	template <typename Policy, typename Reference>
+	void run(const Reference& ref, const std::vector<WorldTriangle>& triangles, int frames, int w, int h, double eye, const double(&camera)[3])
+	{
+		PolicyPipeline<Policy> pipeline(w, h, eye, camera);
+		auto start = clock_type::now();
+		for (int frame = 0; frame < frames; ++frame)
+			pipeline.render(triangles);
+		compare("policy", ref, pipeline, elapsed_ms(start), frames);
+	}
+}
+
+int bench(int argc, char* argv [])
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 10;
+	if (frames < 1)
+		frames = 1;
+
+	PlatformAPI init;
+
+	const int width = 1400;
+	const int height = 800;
+	const double eye = 1000;
+	const double camera[3] = { 1007.5, 617.5, -1000 };
+
+	auto scene = std::make_shared<Scene>();
+	setUp(scene);
+	lights(scene);
+
+	std::vector<WorldTriangle> triangles;
+	flatten(triangles, *scene, math::Affine::identity());
+
+	printf("studio test scene: %u triangles, %dx%d, %d frame(s)\n\n", (unsigned) triangles.size(), width, height, frames);
+
+	// transform, project and depth-rasterize the scene with every policy
+	PolicyPipeline<math::float_policy<double>> reference(width, height, eye, camera);
+	reference.render(triangles);
+
+	run<math::float_policy<float>>(reference, triangles, frames, width, height, eye, camera);
+	run<math::float_policy<double>>(reference, triangles, frames, width, height, eye, camera);
+	run<math::q16_policy>(reference, triangles, frames, width, height, eye, camera);
+
+	// the whole renderer can only run with the policy it was built with
+	math::Vertex camPos{ fixed(camera[0]), fixed(camera[1]), fixed(camera[2]) };
+	auto cam = scene->add<Camera>(fixed(eye), camPos, camPos + math::Vertex(0, 0, 100));
+
+	static const struct
+	{
+		Render render;
+		Raster type;
+		bool deferred;
+		const char* name;
+	} rasters [] = {
+		{ Render::Solid, Raster::Scanline, false, "scanline" },
+		{ Render::Solid, Raster::HalfSpace, false, "halfspace" },
+		{ Render::Solid, Raster::HalfSpace, true, "deferred" },
+		{ Render::Gouraud, Raster::HalfSpace, false, "gouraud" },
+		{ Render::Flat, Raster::HalfSpace, false, "flat" },
+	};
+
+	printf("\n");
+	for (auto && raster : rasters)
+	{
+		double ms = 0;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			auto canvas = cam->create_canvas<SimpleCanvas<ColorDepthBitmap>>(width, height);
+			canvas->setRenderType(raster.render);
+			canvas->setRasterType(raster.type);
+			canvas->setDeferred(raster.deferred);
+
+			auto start = clock_type::now();
+			scene->renderTo(cam.get());
+			ms += elapsed_ms(start);
+		}
+
+		auto && stats = cam->stats();
+		printf("%-8s %-10s %-10s %-8s %10.2f ms/frame   culled %u/%u (%u back-facing, %u off-screen), %u nodes hidden\n", "render", math::fixed_policy::name(), raster.name, depth_format::name(), ms / frames,
+			stats.culled(), stats.faces, stats.backFacing, stats.offScreen, stats.hidden);
+	}
+
+	scene.reset();
+	return 0;
+}
@@ -35,6 +35,7 @@
 #include <block.hpp>
 #include <platform_api.hpp>
 #include <canvas_types.hpp>
+#include <shadow_cache.hpp>
 
 #include <future>
 #include <iomanip>
@@ -42,6 +43,8 @@
 #include <sstream>
 
 #define DEPTH_BUFFER
+#define DEFERRED_SHADING
+#define SHADOW_MAPS
 //#define STEREO_CAMERA
 #define CYAN_MAGENTA
 
@@ -125,9 +128,11 @@ Command* get_cmmd(Command (&commands)[N], int argc, char* argv[])
 }
 
 int test(int, char* []);
+int bench(int, char* []);
 
 Command commands[] = {
-	Command("test", test)
+	Command("test", test),
+	Command("bench", bench)
 };
 
 int main(int argc, char* argv[])
@@ -228,15 +233,19 @@ std::shared_ptr<CanvasT> create_canvas(const std::shared_ptr<studio::Scene>& sce
 	return cam->create_canvas<CanvasT>(1400, 800);
 }
 
-std::shared_ptr<PlatformBitmap<BitmapType::G8>> calcShadow(Camera* camera, CanvasType* canvas, Light* light, int i)
+ShadowMaskPtr calcShadow(ShadowCache* cache, const Scene* scene, Camera* camera, CanvasType* canvas, Light* light, int i)
 {
 	std::ostringstream o;
 	o << "shadow_" << i << ".png";
 
+#ifdef SHADOW_MAPS
+	auto shadow = cache->mask(*scene, *light, *camera, *canvas);
+#else
 	auto _pos = light->position();
-	camera->transform(_pos, math::Matrix::identity());
+	camera->transform(_pos, math::Affine::identity());
 	auto pos = camera->project(_pos);
 	auto shadow = canvas->calcShadow(pos, _pos.z());
+#endif
 	shadow->save(o.str().c_str());
 	return shadow;
 }
@@ -251,9 +260,14 @@ int test(int argc, char* argv [])
 	auto canvas = create_canvas<CanvasType>(scene);
 #ifdef DEPTH_BUFFER
 	canvas->setRenderType(Render::Solid);
+#  ifdef DEFERRED_SHADING
+	canvas->setDeferred(true);
+#  endif
 #endif
 
+	std::cout << "render" << std::flush;
 	scene->renderAllCameras();
+	std::cout << ". " << std::flush;
 #if defined(DEPTH_BUFFER) && !defined(STEREO_CAMERA)
 	canvas->saveDepths("depths.png");
 
@@ -266,34 +280,34 @@ int test(int argc, char* argv [])
 	// it not compiled on the matching lambda to the async
 	auto camera = std::static_pointer_cast<CanvasTraits<CanvasType>::CameraType>(icam);
 
-	std::vector< std::future< std::shared_ptr<PlatformBitmap<BitmapType::G8>> > > tasks;
+	std::vector< std::future<ShadowMaskPtr> > tasks;
+	ShadowCache cache;
 
 	for (auto && light : lights)
 	{
-		tasks.push_back(std::async([=](Camera* camera, CanvasType* canvas, Light* light, int i) {
+		tasks.push_back(std::async([=](ShadowCache* cache, const Scene* scene, Camera* camera, CanvasType* canvas, Light* light, int i) {
 			std::ostringstream o1, o2;
 
 			o1 << "<" << i;
 			std::cout << o1.str() << std::flush;
 
-			auto sh = calcShadow(camera, canvas, light, i);
+			auto sh = calcShadow(cache, scene, camera, canvas, light, i);
 			o2 << i << ">";
 			std::cout << o2.str() << std::flush;
 			return sh;
-		}, camera.get(), canvas.get(), light.get(), ++i));
+		}, &cache, scene.get(), camera.get(), canvas.get(), light.get(), ++i));
 	}
 
+	std::vector<ShadowMaskPtr> shadows;
 	for (auto && task : tasks)
-	{
-		auto sh = task.get();
-		canvas->applyShadow(sh.get());
-	}
+		shadows.push_back(task.get());
+	canvas->applyShadow(shadows);
 
 	for (auto && light : lights)
 	{
 		[=](Camera* camera, CanvasType* canvas, Light* light){
 			auto p0 = light->position();
-			camera->transform(p0, math::Matrix::identity());
+			camera->transform(p0, math::Affine::identity());
 			auto p1 = camera->project(p0);
 			p1 = canvas->tr(p1);
 			canvas->plot(cast<int>(p1.x()), cast<int>(p1.y()), Color(0xFF, 1, 1));